@@ -0,0 +1,186 @@
+/*
+ *
+ * Page Allocator Benchmark
+ *
+ *    Measures:
+ *      ms to create a BUFFER_SIZE buffer, ns per value
+ *      and page faults on the first pass through it,
+ *      ns per random read, and the huge pages used,
+ *      for calloc and each kind of pageAlloc mapping
+ *
+ *    Build:
+ *      gcc -O2 page-allocator-benchmark.c
+ *
+ * Notes:
+ *
+ * The first pass writes every value in order, as the
+ * producer of a fresh array queue does. Without
+ * prefaulting, it takes one page fault per page, on the
+ * hot path. The random reads then jump around the whole
+ * buffer, so nearly every read needs a TLB entry that is
+ * not cached, which is where huge pages pay off.
+ *
+ * Explicit huge pages need a reserved pool, e.g.
+ *
+ *   echo 512 > /proc/sys/vm/nr_hugepages
+ *
+ * Without one they fall back to transparent huge pages,
+ * as the fallback column shows.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "page-allocator.h"
+
+#define BUFFER_SIZE ((size_t) 512 << 20)
+#define RANDOM_READS 20000000
+
+static volatile long sink;
+
+typedef struct setup {
+    const char* label;
+    int use_calloc;
+    page_options options;
+} setup;
+
+// Benchmark
+void run(const setup*);
+
+// Helper Function(s)
+double secondsSince(struct timespec*);
+long minorFaults(void);
+long anonHugeKb(void);
+
+int main() {
+    const setup setups[] = {
+        {"calloc", 1, {PAGES_SMALL, PAGE_NODE_ANY, 0}},
+        {"small", 0, {PAGES_SMALL, PAGE_NODE_LOCAL, 0}},
+        {"small+prefault", 0, {PAGES_SMALL, PAGE_NODE_LOCAL, 1}},
+        {"thp", 0, {PAGES_TRANSPARENT_HUGE, PAGE_NODE_LOCAL, 0}},
+        {"thp+prefault", 0, {PAGES_TRANSPARENT_HUGE, PAGE_NODE_LOCAL, 1}},
+        {"explicit+prefault", 0, {PAGES_EXPLICIT_HUGE, PAGE_NODE_LOCAL, 1}},
+    };
+
+    printf("%-18s %10s %10s %10s %10s %10s %9s\n", "", "create ms", "pass ns",
+           "pass flts", "random ns", "huge MB", "fallback");
+
+    for (size_t i = 0; i < sizeof(setups) / sizeof(setups[0]); i++)
+        run(&setups[i]);
+
+    page_stats stats = pageReadStats();
+    printf("\npages: %ld mappings, %ld explicit huge, %ld fallbacks, %ld bind failures\n",
+           stats.mappings, stats.explicit_huge, stats.huge_fallbacks, stats.bind_failures);
+
+    return 0;
+}
+
+/*
+ *
+ * Benchmark
+ *
+ */
+
+/// Creates a buffer the way setup says, writes it
+/// once in order, reads it at random and prints the
+/// measurements.
+/// \param setup
+void run(const setup* setup) {
+    size_t size = BUFFER_SIZE;
+    long fallbacks = pageReadStats().huge_fallbacks;
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int* values = setup->use_calloc ? calloc(1, size) : pageAlloc(&size, &setup->options);
+    double create = secondsSince(&start);
+
+    if (values == NULL) {
+        printf("%-18s out of memory\n", setup->label);
+        return;
+    }
+
+    size_t count = BUFFER_SIZE / sizeof(int);
+    long faults = minorFaults();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < count; i++)
+        values[i] = (int) i;
+
+    double pass = secondsSince(&start);
+    faults = minorFaults() - faults;
+
+    // xorshift, so the reads do not wait on rand().
+    unsigned long state = 88172645463325252ul;
+    long sum = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int i = 0; i < RANDOM_READS; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        sum += values[state % count];
+    }
+
+    double random = secondsSince(&start);
+    sink = sum; // Keeps the reads.
+    long huge_kb = anonHugeKb();
+
+    printf("%-18s %10.1f %10.2f %10ld %10.1f %10ld %9s\n", setup->label, create * 1e3,
+           pass * 1e9 / count, faults, random * 1e9 / RANDOM_READS, huge_kb / 1024,
+           pageReadStats().huge_fallbacks > fallbacks ? "yes" : "");
+
+    if (setup->use_calloc)
+        free(values);
+    else
+        pageFree(values, size);
+}
+
+/*
+ * Helper Function(s)
+ *
+ */
+
+/// Returns the seconds elapsed since start.
+/// \param start
+/// \return seconds
+double secondsSince(struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/// Returns the minor page faults of this process
+/// so far.
+/// \return faults
+long minorFaults(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+/// Returns the memory of this process backed by
+/// transparent or explicit huge pages.
+/// \return kB, or 0 if unknown
+long anonHugeKb(void) {
+    char line[256];
+    long total = 0;
+    long kb;
+    FILE* smaps = fopen("/proc/self/smaps_rollup", "r");
+
+    if (smaps == NULL)
+        return 0;
+
+    while (fgets(line, sizeof(line), smaps) != NULL) {
+        if (sscanf(line, "AnonHugePages: %ld", &kb) == 1
+            || sscanf(line, "Private_Hugetlb: %ld", &kb) == 1)
+            total += kb;
+    }
+
+    fclose(smaps);
+    return total;
+}
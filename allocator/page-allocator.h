@@ -0,0 +1,253 @@
+/*
+ *
+ * Page Allocator
+ *
+ *    Uses:
+ *      mmap, Huge Pages, NUMA Binding
+ *
+ *    Sample Operations:
+ *      pageAlloc, pageResize, pageFree, pageReadStats
+ *
+ *    Usage:
+ *      #define _GNU_SOURCE // Before any #include.
+ *      #include "../allocator/page-allocator.h"
+ *
+ *      page_options options = {PAGES_TRANSPARENT_HUGE, PAGE_NODE_LOCAL, 1};
+ *      size_t size = capacity * sizeof(int);
+ *      int* array = pageAlloc(&size, &options);
+ *      ...
+ *      pageFree(array, size);
+ *
+ * Notes:
+ *
+ * A queue or stack with a buffer of a few gigabytes spends
+ * a surprising part of its time outside its own code. Each
+ * 4 KB page of the buffer needs its own TLB entry, so a
+ * ring that is walked end to end misses the TLB on nearly
+ * every page. Each page is also faulted in by the first
+ * write to it, on the hot path, and lands on whatever NUMA
+ * node the writing thread happened to run on.
+ *
+ * pageAlloc maps the buffer directly with mmap and fixes
+ * all three when the buffer is created:
+ *
+ *   pages     PAGES_SMALL uses normal pages.
+ *             PAGES_TRANSPARENT_HUGE aligns the mapping
+ *             to PAGE_HUGE_SIZE and asks the kernel to
+ *             back it with transparent huge pages, one
+ *             TLB entry per 2 MB. The kernel may still
+ *             use small pages when it finds no free
+ *             huge page.
+ *             PAGES_EXPLICIT_HUGE takes pages from the
+ *             reserved huge page pool (vm.nr_hugepages),
+ *             which are never split or swapped. If the
+ *             pool is too small it falls back to
+ *             transparent huge pages.
+ *   node      PAGE_NODE_ANY leaves placement to the
+ *             kernel. PAGE_NODE_LOCAL binds the memory to
+ *             the NUMA node of the calling thread, so
+ *             create the buffer on the consumer thread.
+ *             Any other value is a node number.
+ *   prefault  faults every page in before pageAlloc
+ *             returns, so the hot path never does.
+ *
+ * The mapping is a whole number of pages. pageAlloc
+ * rounds size up and passes the mapped size back, and
+ * pageResize and pageFree need it again. The memory
+ * starts out zeroed, as from calloc.
+ *
+ * NUMA binding calls mbind directly, so there is no
+ * dependency on libnuma. It is strict: if the node runs
+ * out of memory the process gets no pages from other
+ * nodes. A bind that fails (no NUMA support, bad node)
+ * is counted in pageReadStats and otherwise ignored.
+ *
+ * Every function is static inline, like the slab
+ * allocator, and needs _GNU_SOURCE for the Linux flags.
+ *
+ */
+
+#ifndef ALLOCATOR_PAGE_ALLOCATOR_H
+#define ALLOCATOR_PAGE_ALLOCATOR_H
+
+#ifndef _GNU_SOURCE
+#error "Define _GNU_SOURCE before any #include to use the page allocator."
+#endif
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define PAGE_HUGE_SIZE ((size_t) 2 << 20) // Default huge page on x86-64 and arm64.
+#define PAGE_NODE_ANY (-1)
+#define PAGE_NODE_LOCAL (-2)
+#define PAGE_MPOL_BIND 2 // From <numaif.h>, which needs libnuma.
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23 // Linux 5.14.
+#endif
+
+typedef enum page_kind {
+    PAGES_SMALL,
+    PAGES_TRANSPARENT_HUGE,
+    PAGES_EXPLICIT_HUGE
+} page_kind;
+
+typedef struct page_options {
+    page_kind pages;
+    int node; // PAGE_NODE_ANY, PAGE_NODE_LOCAL or a node.
+    int prefault; // 1 to fault all pages in up front.
+} page_options;
+
+typedef struct page_stats {
+    long mappings; // Successful pageAlloc calls.
+    long explicit_huge; // Mappings from the huge page pool.
+    long huge_fallbacks; // PAGES_EXPLICIT_HUGE that fell back.
+    long bind_failures;
+} page_stats;
+
+static page_stats page_counters;
+
+/// Rounds size up to a multiple of unit, a power of two.
+static inline size_t pageRound(size_t size, size_t unit) {
+    return (size + unit - 1) & ~(unit - 1);
+}
+
+/// Binds memory to a NUMA node and faults it in, as
+/// options say.
+/// \param memory
+/// \param size
+/// \param options
+static inline void pagePlace(char* memory, size_t size, const page_options* options) {
+    int node = options->node;
+
+    if (node == PAGE_NODE_LOCAL) {
+        unsigned cpu;
+        unsigned local_node;
+        node = syscall(SYS_getcpu, &cpu, &local_node, NULL) == 0 ? (int) local_node : -1;
+    }
+
+    if (options->node != PAGE_NODE_ANY) {
+        // Before the first touch, which is when the page
+        // is actually allocated.
+        unsigned long mask = node >= 0 && node < 64 ? 1ul << node : 0;
+        if (mask == 0
+            || syscall(SYS_mbind, memory, size, PAGE_MPOL_BIND, &mask, 64ul, 0u) != 0)
+            __atomic_fetch_add(&page_counters.bind_failures, 1, __ATOMIC_RELAXED);
+    }
+
+    if (options->prefault && size > 0 && madvise(memory, size, MADV_POPULATE_WRITE) != 0) {
+        // Older kernel. Write a zero to each page,
+        // which the page holds already.
+        size_t step = (size_t) sysconf(_SC_PAGESIZE);
+        for (size_t offset = 0; offset < size; offset += step)
+            ((volatile char*) memory)[offset] = 0;
+    }
+}
+
+/// Maps zeroed memory as options say.
+/// \param size bytes wanted, receives the bytes mapped
+/// \param options
+/// \return the memory, or NULL if size is 0 or out of
+/// memory
+static inline void* pageAlloc(size_t* size, const page_options* options) {
+    if (*size == 0)
+        return NULL; // Nothing to map, and no size to unmap.
+
+    int protection = PROT_READ | PROT_WRITE;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    page_kind pages = options->pages;
+    char* memory = MAP_FAILED;
+    size_t mapped = 0;
+
+    if (pages == PAGES_EXPLICIT_HUGE) {
+        mapped = pageRound(*size, PAGE_HUGE_SIZE);
+        memory = mmap(NULL, mapped, protection, flags | MAP_HUGETLB, -1, 0);
+
+        if (memory != MAP_FAILED) {
+            __atomic_fetch_add(&page_counters.explicit_huge, 1, __ATOMIC_RELAXED);
+        } else {
+            __atomic_fetch_add(&page_counters.huge_fallbacks, 1, __ATOMIC_RELAXED);
+            pages = PAGES_TRANSPARENT_HUGE;
+        }
+    }
+
+    if (pages == PAGES_TRANSPARENT_HUGE) {
+        // Transparent huge pages only back aligned 2 MB
+        // ranges, so map one huge page extra and trim
+        // the mapping to a huge page boundary.
+        mapped = pageRound(*size, PAGE_HUGE_SIZE);
+        char* raw = mmap(NULL, mapped + PAGE_HUGE_SIZE, protection, flags, -1, 0);
+        if (raw == MAP_FAILED)
+            return NULL;
+
+        memory = (char*) pageRound((uintptr_t) raw, PAGE_HUGE_SIZE);
+        if (memory > raw)
+            munmap(raw, memory - raw);
+        munmap(memory + mapped, raw + PAGE_HUGE_SIZE - memory);
+
+        madvise(memory, mapped, MADV_HUGEPAGE);
+    } else if (pages == PAGES_SMALL) {
+        mapped = pageRound(*size, (size_t) sysconf(_SC_PAGESIZE));
+        memory = mmap(NULL, mapped, protection, flags, -1, 0);
+        if (memory == MAP_FAILED)
+            return NULL;
+    }
+
+    pagePlace(memory, mapped, options);
+    __atomic_fetch_add(&page_counters.mappings, 1, __ATOMIC_RELAXED);
+
+    *size = mapped;
+    return memory;
+}
+
+/// Unmaps memory from pageAlloc or pageResize.
+/// \param memory
+/// \param size the size they passed back
+static inline void pageFree(void* memory, size_t size) {
+    if (memory != NULL)
+        munmap(memory, size);
+}
+
+/// Moves the first keep bytes of memory to a mapping
+/// of at least size bytes. When the rounded size is
+/// what is mapped already, memory is returned as is.
+/// \param memory
+/// \param old_size the size pageAlloc passed back
+/// \param keep bytes to keep, at most the new size
+/// \param size bytes wanted, receives the bytes mapped
+/// \param options
+/// \return the memory, or NULL if size is 0 or out of
+/// memory, and the old memory is unchanged
+static inline void* pageResize(void* memory, size_t old_size, size_t keep, size_t* size,
+                               const page_options* options) {
+    size_t unit = options->pages == PAGES_SMALL ? (size_t) sysconf(_SC_PAGESIZE) : PAGE_HUGE_SIZE;
+
+    if (pageRound(*size, unit) == old_size) {
+        *size = old_size;
+        return memory;
+    }
+
+    void* new_memory = pageAlloc(size, options);
+    if (new_memory == NULL)
+        return NULL;
+
+    memcpy(new_memory, memory, keep);
+    pageFree(memory, old_size);
+
+    return new_memory;
+}
+
+/// Returns the allocator's counters.
+static inline page_stats pageReadStats(void) {
+    page_stats stats;
+    stats.mappings = __atomic_load_n(&page_counters.mappings, __ATOMIC_RELAXED);
+    stats.explicit_huge = __atomic_load_n(&page_counters.explicit_huge, __ATOMIC_RELAXED);
+    stats.huge_fallbacks = __atomic_load_n(&page_counters.huge_fallbacks, __ATOMIC_RELAXED);
+    stats.bind_failures = __atomic_load_n(&page_counters.bind_failures, __ATOMIC_RELAXED);
+    return stats;
+}
+
+#endif
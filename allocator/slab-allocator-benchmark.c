@@ -0,0 +1,252 @@
+/*
+ *
+ * Slab Allocator Benchmark
+ *
+ *    Measures:
+ *      ns per allocate and free pair, for malloc and
+ *      slabAlloc, on one thread and across threads,
+ *      and the memory used per 16-byte node
+ *
+ *    Build:
+ *      gcc -O2 -pthread slab-allocator-benchmark.c
+ *
+ * Notes:
+ *
+ * The churn test allocates a batch of nodes and frees them
+ * again, newest first, the way a stack or queue built from
+ * linked nodes does. In the handoff test one thread allocates
+ * every node and another frees it, like the producer and
+ * consumer of a linked list queue, which is where the
+ * cross-thread batching of the magazines matters.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "slab-allocator.h"
+
+#define NODE_SIZE 16 // An int and a pointer, as in the linked lists.
+#define CHURN_BATCH 1000
+#define CHURN_ROUNDS 2000
+#define HANDOFF_NODES 2000000
+#define HANDOFF_BATCH 256 // Nodes per handoff.
+#define FOOTPRINT_NODES 1000000
+
+typedef enum allocator {
+    MALLOC,
+    SLAB
+} allocator;
+
+typedef struct handoff {
+    allocator allocator;
+    void* batches[2][HANDOFF_BATCH];
+    int ready[2]; // Batch is full and waiting for the consumer.
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} handoff;
+
+// Benchmark
+double churn(allocator);
+double handOff(allocator);
+void* consume(void*);
+double footprint(allocator);
+
+// Helper Function(s)
+void* allocate(allocator);
+void release(allocator, void*);
+double secondsSince(struct timespec*);
+long currentRss(void);
+
+int main() {
+    const char* labels[] = {"malloc", "slab"};
+    double bytes[2];
+
+    // Memory first, and slab before malloc: memory freed
+    // by malloc would be reused by the slabs without
+    // growing the resident set, while slabs are never
+    // given back to malloc.
+    bytes[SLAB] = footprint(SLAB);
+    bytes[MALLOC] = footprint(MALLOC);
+
+    printf("%-8s %14s %14s %14s\n", "", "churn ns", "handoff ns", "bytes/node");
+
+    for (int i = MALLOC; i <= SLAB; i++) {
+        printf("%-8s %14.1f %14.1f %14.1f\n", labels[i],
+               churn(i), handOff(i), bytes[i]);
+    }
+
+    slab_stats stats = slabReadStats();
+    printf("\nslab: %ld slabs, %ld depot trades, %ld large allocations\n",
+           stats.slabs, stats.depot_trades, stats.large);
+
+    return 0;
+}
+
+/*
+ *
+ * Benchmark
+ *
+ */
+
+/// Allocates CHURN_BATCH nodes and frees them newest
+/// first, CHURN_ROUNDS times.
+/// \param allocator
+/// \return ns per allocate and free pair
+double churn(allocator allocator) {
+    static void* nodes[CHURN_BATCH];
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int round = 0; round < CHURN_ROUNDS; round++) {
+        for (int i = 0; i < CHURN_BATCH; i++)
+            nodes[i] = allocate(allocator);
+        for (int i = CHURN_BATCH - 1; i >= 0; i--)
+            release(allocator, nodes[i]);
+    }
+
+    return secondsSince(&start) * 1e9 / ((double) CHURN_BATCH * CHURN_ROUNDS);
+}
+
+/// Allocates HANDOFF_NODES nodes on this thread and frees
+/// them on another, passing them over in batches through
+/// two buffers.
+/// \param allocator
+/// \return ns per allocate and free pair
+double handOff(allocator allocator) {
+    handoff shared = {.allocator = allocator};
+    pthread_mutex_init(&shared.lock, NULL);
+    pthread_cond_init(&shared.changed, NULL);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_t consumer;
+    pthread_create(&consumer, NULL, consume, &shared);
+
+    for (int sent = 0, buffer = 0; sent < HANDOFF_NODES; sent += HANDOFF_BATCH, buffer ^= 1) {
+        pthread_mutex_lock(&shared.lock);
+        while (shared.ready[buffer])
+            pthread_cond_wait(&shared.changed, &shared.lock);
+        pthread_mutex_unlock(&shared.lock);
+
+        for (int i = 0; i < HANDOFF_BATCH; i++)
+            shared.batches[buffer][i] = allocate(allocator);
+
+        pthread_mutex_lock(&shared.lock);
+        shared.ready[buffer] = 1;
+        pthread_cond_broadcast(&shared.changed);
+        pthread_mutex_unlock(&shared.lock);
+    }
+
+    pthread_join(consumer, NULL);
+
+    double seconds = secondsSince(&start);
+
+    pthread_cond_destroy(&shared.changed);
+    pthread_mutex_destroy(&shared.lock);
+
+    return seconds * 1e9 / HANDOFF_NODES;
+}
+
+/// Frees the batches handed over by handOff.
+/// \param argument the handoff
+/// \return NULL
+void* consume(void* argument) {
+    handoff* shared = argument;
+
+    for (int received = 0, buffer = 0; received < HANDOFF_NODES;
+         received += HANDOFF_BATCH, buffer ^= 1) {
+        pthread_mutex_lock(&shared->lock);
+        while (!shared->ready[buffer])
+            pthread_cond_wait(&shared->changed, &shared->lock);
+        pthread_mutex_unlock(&shared->lock);
+
+        for (int i = 0; i < HANDOFF_BATCH; i++)
+            release(shared->allocator, shared->batches[buffer][i]);
+
+        pthread_mutex_lock(&shared->lock);
+        shared->ready[buffer] = 0;
+        pthread_cond_broadcast(&shared->changed);
+        pthread_mutex_unlock(&shared->lock);
+    }
+
+    return NULL;
+}
+
+/// Measures how much the resident set grows while
+/// FOOTPRINT_NODES nodes are allocated.
+/// \param allocator
+/// \return bytes per node
+double footprint(allocator allocator) {
+    void** nodes = malloc(FOOTPRINT_NODES * sizeof(void*));
+
+    // Touch the pointer array first, so it is not
+    // counted. volatile keeps the compiler from
+    // dropping stores that are overwritten below.
+    for (int i = 0; i < FOOTPRINT_NODES; i++)
+        ((void* volatile*) nodes)[i] = NULL;
+
+    long before = currentRss();
+    for (int i = 0; i < FOOTPRINT_NODES; i++)
+        nodes[i] = allocate(allocator);
+    long after = currentRss();
+
+    for (int i = 0; i < FOOTPRINT_NODES; i++)
+        release(allocator, nodes[i]);
+    free(nodes);
+
+    return (after - before) * 1024.0 / FOOTPRINT_NODES;
+}
+
+/*
+ * Helper Function(s)
+ *
+ */
+
+/// Allocates a zeroed node.
+/// \param allocator
+/// \return the node
+void* allocate(allocator allocator) {
+    if (allocator == MALLOC)
+        return calloc(1, NODE_SIZE);
+    return slabCalloc(NODE_SIZE);
+}
+
+/// Frees a node.
+/// \param allocator
+/// \param node
+void release(allocator allocator, void* node) {
+    if (allocator == MALLOC)
+        free(node);
+    else
+        slabFree(node, NODE_SIZE);
+}
+
+/// Returns the seconds elapsed since start.
+/// \param start
+/// \return seconds
+double secondsSince(struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/// Returns the resident set size of this process.
+/// \return kB, or 0 if unknown
+long currentRss(void) {
+    long pages = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+
+    if (statm != NULL) {
+        if (fscanf(statm, "%*d %ld", &pages) != 1)
+            pages = 0;
+        fclose(statm);
+    }
+
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
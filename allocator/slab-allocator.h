@@ -0,0 +1,351 @@
+/*
+ *
+ * Slab Allocator
+ *
+ *    Uses:
+ *      Size Classes, Per-Thread Magazines
+ *
+ *    Sample Operations:
+ *      slabAlloc, slabCalloc, slabFree, slabReadStats
+ *
+ *    Usage:
+ *      #include "../allocator/slab-allocator.h"
+ *
+ *      node* new_node = slabCalloc(sizeof(node));
+ *      ...
+ *      slabFree(new_node, sizeof(node));
+ *
+ * Notes:
+ *
+ * The linked structures in this repository allocate one small
+ * node per value and free it again soon after. Through malloc
+ * each node pays for a size header and for malloc's search for
+ * a block, and on the steady state path of a queue or stack
+ * that is most of the work.
+ *
+ * Here objects are grouped into size classes, multiples of
+ * SLAB_CLASS_STEP bytes up to SLAB_MAX_SIZE. Each class carves
+ * its objects out of big slabs, so there is no header per
+ * object: the caller passes the size back to slabFree, as it
+ * always knows it. Larger sizes go to malloc and free.
+ *
+ * Each thread keeps, per class, two magazines: arrays of up to
+ * SLAB_MAGAZINE_SIZE free objects. slabAlloc pops from the
+ * loaded magazine and slabFree pushes onto it, with no lock and
+ * no atomic. Only when the loaded magazine is empty (or full)
+ * does the thread look at the other one, and only when both
+ * are does it lock the class's depot and trade a whole
+ * magazine, so the lock is taken once per SLAB_MAGAZINE_SIZE
+ * operations at most. Keeping two magazines stops a thread
+ * that allocates and frees around a magazine boundary from
+ * going to the depot every time.
+ *
+ * A node freed by a thread other than the one that allocated
+ * it simply goes into the freeing thread's magazine. When the
+ * magazine fills, the whole batch goes to the depot, where the
+ * allocating thread picks it up as a full magazine. So a
+ * producer and a consumer thread pass nodes back in batches,
+ * one lock each way per SLAB_MAGAZINE_SIZE nodes.
+ *
+ * When a thread exits, its magazines go back to the depot.
+ * Slabs are never returned to the system: the memory of a
+ * structure that shrinks stays ready for the next one.
+ *
+ * Every function is static inline, so each program that
+ * includes this file gets its own allocator.
+ *
+ */
+
+#ifndef ALLOCATOR_SLAB_ALLOCATOR_H
+#define ALLOCATOR_SLAB_ALLOCATOR_H
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SLAB_CLASS_STEP 16
+#define SLAB_MAX_SIZE 256
+#define SLAB_CLASS_COUNT (SLAB_MAX_SIZE / SLAB_CLASS_STEP)
+#define SLAB_SIZE 65536 // Bytes carved per slab.
+#define SLAB_MAGAZINE_SIZE 64
+
+typedef struct slab_magazine {
+    struct slab_magazine* next; // In a depot list.
+    int count;
+    void* objects[SLAB_MAGAZINE_SIZE];
+} slab_magazine;
+
+typedef struct slab_depot {
+    pthread_mutex_t lock;
+    slab_magazine* full; // Magazines with objects, mostly full.
+    slab_magazine* empty;
+    char* carve; // Next uncarved object of the newest slab.
+    char* carve_end;
+    long slabs;
+} slab_depot;
+
+typedef struct slab_thread_cache {
+    slab_magazine* loaded[SLAB_CLASS_COUNT];
+    slab_magazine* previous[SLAB_CLASS_COUNT];
+    int registered; // Flushed when the thread exits.
+} slab_thread_cache;
+
+typedef struct slab_stats {
+    long slabs; // Slabs carved, all classes.
+    long depot_trades; // Times a thread locked a depot.
+    long large; // Allocations passed to malloc.
+} slab_stats;
+
+// One depot per class.
+static slab_depot slab_depots[SLAB_CLASS_COUNT] = {
+#define SLAB_DEPOT_INIT {PTHREAD_MUTEX_INITIALIZER, NULL, NULL, NULL, NULL, 0}
+    SLAB_DEPOT_INIT, SLAB_DEPOT_INIT, SLAB_DEPOT_INIT, SLAB_DEPOT_INIT,
+    SLAB_DEPOT_INIT, SLAB_DEPOT_INIT, SLAB_DEPOT_INIT, SLAB_DEPOT_INIT,
+    SLAB_DEPOT_INIT, SLAB_DEPOT_INIT, SLAB_DEPOT_INIT, SLAB_DEPOT_INIT,
+    SLAB_DEPOT_INIT, SLAB_DEPOT_INIT, SLAB_DEPOT_INIT, SLAB_DEPOT_INIT
+#undef SLAB_DEPOT_INIT
+};
+
+static _Thread_local slab_thread_cache slab_cache;
+static pthread_key_t slab_exit_key;
+static pthread_once_t slab_exit_once = PTHREAD_ONCE_INIT;
+static long slab_depot_trades;
+static long slab_large;
+
+/// Returns the class of a size from 1 to SLAB_MAX_SIZE.
+static inline int slabClass(size_t size) {
+    return (int) ((size - 1) / SLAB_CLASS_STEP);
+}
+
+/// Gives a thread's magazines back to the depots.
+static inline void slabFlushThread(void* unused) {
+    (void) unused;
+
+    for (int i = 0; i < SLAB_CLASS_COUNT; i++) {
+        slab_magazine* magazines[2] = {slab_cache.loaded[i], slab_cache.previous[i]};
+        slab_depot* depot = &slab_depots[i];
+
+        pthread_mutex_lock(&depot->lock);
+        for (int j = 0; j < 2; j++) {
+            slab_magazine* magazine = magazines[j];
+            if (magazine == NULL)
+                continue;
+
+            if (magazine->count > 0) {
+                magazine->next = depot->full;
+                depot->full = magazine;
+            } else {
+                magazine->next = depot->empty;
+                depot->empty = magazine;
+            }
+        }
+        pthread_mutex_unlock(&depot->lock);
+
+        slab_cache.loaded[i] = NULL;
+        slab_cache.previous[i] = NULL;
+    }
+
+    slab_cache.registered = 0;
+}
+
+static inline void slabCreateExitKey(void) {
+    pthread_key_create(&slab_exit_key, slabFlushThread);
+}
+
+/// Makes sure slabFlushThread runs when this thread exits.
+static inline void slabRegisterThread(void) {
+    if (slab_cache.registered)
+        return;
+
+    pthread_once(&slab_exit_once, slabCreateExitKey);
+    pthread_setspecific(slab_exit_key, &slab_cache);
+    slab_cache.registered = 1;
+}
+
+/// Returns an empty magazine from the depot, or a new one.
+/// The depot lock must be held.
+static inline slab_magazine* slabTakeEmpty(slab_depot* depot) {
+    slab_magazine* magazine = depot->empty;
+
+    if (magazine != NULL) {
+        depot->empty = magazine->next;
+        return magazine;
+    }
+
+    magazine = malloc(sizeof(slab_magazine));
+    if (magazine != NULL)
+        magazine->count = 0;
+
+    return magazine;
+}
+
+/// Fills a magazine with new objects carved from the newest
+/// slab, starting a slab when it runs out. The depot lock
+/// must be held.
+static inline void slabCarve(slab_depot* depot, slab_magazine* magazine, size_t object_size) {
+    while (magazine->count < SLAB_MAGAZINE_SIZE) {
+        if (depot->carve == depot->carve_end) {
+            char* slab = malloc(SLAB_SIZE);
+            if (slab == NULL)
+                return;
+
+            depot->carve = slab;
+            depot->carve_end = slab + SLAB_SIZE / object_size * object_size;
+            depot->slabs++;
+        }
+
+        magazine->objects[magazine->count++] = depot->carve;
+        depot->carve += object_size;
+    }
+}
+
+/// Refills the loaded magazine of a class.
+static inline int slabRefill(int class_index) {
+    slab_magazine** loaded = &slab_cache.loaded[class_index];
+    slab_magazine** previous = &slab_cache.previous[class_index];
+
+    // The other magazine has objects: swap.
+    if (*previous != NULL && (*previous)->count > 0) {
+        slab_magazine* swap = *loaded;
+        *loaded = *previous;
+        *previous = swap;
+        return 1;
+    }
+
+    slabRegisterThread();
+
+    slab_depot* depot = &slab_depots[class_index];
+    pthread_mutex_lock(&depot->lock);
+    __atomic_fetch_add(&slab_depot_trades, 1, __ATOMIC_RELAXED);
+
+    // Trade the empty magazine for a full one, or
+    // fill it from the slab.
+    if (depot->full != NULL) {
+        slab_magazine* full = depot->full;
+        depot->full = full->next;
+
+        if (*loaded != NULL) {
+            (*loaded)->next = depot->empty;
+            depot->empty = *loaded;
+        }
+        *loaded = full;
+    } else {
+        if (*loaded == NULL)
+            *loaded = slabTakeEmpty(depot);
+        if (*loaded != NULL)
+            slabCarve(depot, *loaded, (size_t) (class_index + 1) * SLAB_CLASS_STEP);
+    }
+
+    pthread_mutex_unlock(&depot->lock);
+
+    return *loaded != NULL && (*loaded)->count > 0;
+}
+
+/// Makes room in the loaded magazine of a class.
+static inline int slabDrain(int class_index) {
+    slab_magazine** loaded = &slab_cache.loaded[class_index];
+    slab_magazine** previous = &slab_cache.previous[class_index];
+
+    // The other magazine is empty: swap.
+    if (*loaded != NULL && *previous != NULL && (*previous)->count == 0) {
+        slab_magazine* swap = *loaded;
+        *loaded = *previous;
+        *previous = swap;
+        return 1;
+    }
+
+    slabRegisterThread();
+
+    slab_depot* depot = &slab_depots[class_index];
+    pthread_mutex_lock(&depot->lock);
+    __atomic_fetch_add(&slab_depot_trades, 1, __ATOMIC_RELAXED);
+
+    // Hand the older full magazine to the depot, keep
+    // the current one as previous and load an empty one.
+    if (*previous != NULL && (*previous)->count > 0) {
+        (*previous)->next = depot->full;
+        depot->full = *previous;
+    } else if (*previous != NULL) {
+        (*previous)->next = depot->empty;
+        depot->empty = *previous;
+    }
+
+    *previous = *loaded;
+    *loaded = slabTakeEmpty(depot);
+
+    pthread_mutex_unlock(&depot->lock);
+
+    return *loaded != NULL;
+}
+
+/// Allocates size bytes, aligned to SLAB_CLASS_STEP.
+/// Returns NULL if out of memory.
+static inline void* slabAlloc(size_t size) {
+    if (size == 0 || size > SLAB_MAX_SIZE) {
+        __atomic_fetch_add(&slab_large, 1, __ATOMIC_RELAXED);
+        return malloc(size);
+    }
+
+    int class_index = slabClass(size);
+    slab_magazine* loaded = slab_cache.loaded[class_index];
+
+    if (loaded == NULL || loaded->count == 0) {
+        if (!slabRefill(class_index))
+            return NULL;
+        loaded = slab_cache.loaded[class_index];
+    }
+
+    return loaded->objects[--loaded->count];
+}
+
+/// Allocates size zeroed bytes. Returns NULL if out of memory.
+static inline void* slabCalloc(size_t size) {
+    void* memory = slabAlloc(size);
+    if (memory != NULL)
+        memset(memory, 0, size);
+    return memory;
+}
+
+/// Frees memory from slabAlloc or slabCalloc. size must be
+/// the size it was allocated with. Any thread may free it.
+static inline void slabFree(void* memory, size_t size) {
+    if (memory == NULL)
+        return;
+
+    if (size == 0 || size > SLAB_MAX_SIZE) {
+        free(memory);
+        return;
+    }
+
+    int class_index = slabClass(size);
+    slab_magazine* loaded = slab_cache.loaded[class_index];
+
+    if (loaded == NULL || loaded->count == SLAB_MAGAZINE_SIZE) {
+        if (!slabDrain(class_index)) {
+            // No memory for a magazine: keep the object
+            // out of circulation rather than lose track.
+            return;
+        }
+        loaded = slab_cache.loaded[class_index];
+    }
+
+    loaded->objects[loaded->count++] = memory;
+}
+
+/// Reads the allocator's counters.
+static inline slab_stats slabReadStats(void) {
+    slab_stats stats = {0, 0, 0};
+
+    for (int i = 0; i < SLAB_CLASS_COUNT; i++) {
+        pthread_mutex_lock(&slab_depots[i].lock);
+        stats.slabs += slab_depots[i].slabs;
+        pthread_mutex_unlock(&slab_depots[i].lock);
+    }
+
+    stats.depot_trades = __atomic_load_n(&slab_depot_trades, __ATOMIC_RELAXED);
+    stats.large = __atomic_load_n(&slab_large, __ATOMIC_RELAXED);
+
+    return stats;
+}
+
+#endif
@@ -3,13 +3,20 @@
  * Binary Search Tree
  *
  *    Sample Operations:
- *      add, find, contains, depth
+ *      add, find, contains, depth, freeTree
+ *
+ *    Instrumentation (-DINSTRUMENT):
+ *      bst.add_visited, bst.depth_visited,
+ *      bst.contains, bst.find_visited, bst.nodes
  *
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "../allocator/slab-allocator.h"
+#include "../instrumentation/instrumentation.h"
+
 typedef struct node {
     int value;
     struct node* left;
@@ -23,7 +30,9 @@ int contains(node*, int);
 int depth(node*, int);
 
 // Helper Function(s)
+node* findCounting(node*, int, int*);
 node* createNode(int);
+void freeTree(node*);
 
 int main() {
     node* root = createNode(40);
@@ -50,6 +59,10 @@ int main() {
         printf("Depth  %2d? %d\n", i, depth(root, i));
     }
 
+    INSTRUMENT_DUMP(stdout);
+
+    freeTree(root);
+
     return 0;
 }
 
@@ -67,45 +80,47 @@ int main() {
 /// \return the value if added, otherwise -1
 int add(node* root, int value) {
     node* current_node = root;
+    int result = -1;
+    int visited = 0;
 
     while (current_node != NULL) {
+        visited++;
         if (value < current_node->value) {
             if (current_node->left == NULL) {
                 current_node->left = createNode(value);
-                return value;
+                result = value;
+                break;
             } else
                 current_node = current_node->left;
         } else if (value > current_node->value) {
             if (current_node->right == NULL) {
                 current_node->right = createNode(value);
-                return value;
+                result = value;
+                break;
             } else
                 current_node = current_node->right;
         } else
-            return -1;
+            break;
     }
 
-    return -1;
+    INSTRUMENT_RECORD(bst, add_visited, visited);
+
+    return result;
 }
 
 /// Returns the node with the value in
-/// the BST using a tail recursive function
-/// for kicks. Compiler should optimize it.
-/// \param a_node
+/// the BST. The nodes visited are recorded
+/// once per call, not once per level.
+/// \param root
 /// \param value
 /// \return the node if found, otherwise NULL
-node* find(node* a_node, int value) {
-    // Base Tests
-    if (a_node == NULL) return NULL;
-    if (a_node->value == value) return a_node;
+node* find(node* root, int value) {
+    int visited = 0;
+    node* found = findCounting(root, value, &visited);
 
-    if (value < a_node->value)
-        a_node = a_node->left;
-    else
-        a_node = a_node->right;
+    INSTRUMENT_RECORD(bst, find_visited, visited);
 
-    // Tail Recursion
-    return find(a_node, value);
+    return found;
 }
 
 /// Determines if a value is in the BST.
@@ -113,6 +128,7 @@ node* find(node* a_node, int value) {
 /// \param value
 /// \return 1 if found, otherwise 0
 int contains(node* root, int value) {
+    INSTRUMENT_COUNT(bst, contains, 1);
     return find(root, value) != NULL;
 }
 
@@ -127,14 +143,16 @@ int depth(node* root, int value) {
     while (current_node != NULL) {
         depth++;
         if (current_node->value == value)
-            return depth;
+            break;
         else if (value < current_node->value) {
             current_node = current_node->left;
         } else
             current_node = current_node->right;
     }
 
-    return -1;
+    INSTRUMENT_RECORD(bst, depth_visited, depth + 1);
+
+    return current_node == NULL ? -1 : depth;
 }
 
 /*
@@ -142,11 +160,56 @@ int depth(node* root, int value) {
 *
 */
 
-/// Creates a node containing the given value.
+/// Does the work of find using a tail
+/// recursive function for kicks. Compiler
+/// should optimize it.
+/// \param a_node
+/// \param value
+/// \param visited incremented once per node visited
+/// \return the node if found, otherwise NULL
+node* findCounting(node* a_node, int value, int* visited) {
+    // Base Tests
+    if (a_node == NULL) return NULL;
+    (*visited)++;
+    if (a_node->value == value) return a_node;
+
+    if (value < a_node->value)
+        a_node = a_node->left;
+    else
+        a_node = a_node->right;
+
+    // Tail Recursion
+    return findCounting(a_node, value, visited);
+}
+
+/// Creates a node containing the given value,
+/// allocated from the slab allocator.
 /// \param value
 /// \return the node
 node* createNode(int value) {
-    node* new_node = calloc(1, sizeof(node));
+    node* new_node = slabCalloc(sizeof(node));
     new_node->value = value;
+    INSTRUMENT_COUNT(bst, nodes, 1);
     return new_node;
 }
+
+/// Frees every node of the tree. It rotates each left
+/// child up until the root has none, and then frees the
+/// root, so a degenerate tree needs no stack.
+/// \param root
+void freeTree(node* root) {
+    while (root != NULL) {
+        node* next;
+
+        if (root->left != NULL) {
+            next = root->left;
+            root->left = next->right;
+            next->right = root;
+        } else {
+            next = root->right;
+            slabFree(root, sizeof(node));
+        }
+
+        root = next;
+    }
+}
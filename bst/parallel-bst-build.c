@@ -0,0 +1,694 @@
+/*
+ *
+ * Parallel Bulk Build and Batched Lookup for the BST
+ *
+ *    Uses:
+ *      Radix Sort, Fork-Join Scheduler
+ *
+ *    Sample Operations:
+ *      buildBalanced, containsBatch, freeBulkTree
+ *
+ *    Options:
+ *      -n keys       unsorted keys to build from (default 4M)
+ *      -q queries    keys to look up (default 4M)
+ *      -w workers    most worker threads to try, up to 64
+ *                    (default the number of CPUs)
+ *
+ *    Build:
+ *      gcc -O2 -pthread parallel-bst-build.c
+ *
+ * Notes:
+ *
+ * Building a tree from unsorted keys with add() costs a walk
+ * from the root per key, each step a likely cache miss, on
+ * one thread, and random keys still leave the tree about
+ * twice as deep as it needs to be. buildBalanced does it in
+ * three steps instead, all on the work-stealing scheduler of
+ * stack/work-stealing-deque.c:
+ *
+ *   sort    an LSD radix sort, 8 bits per pass. The keys are
+ *           split into blocks. Each worker counts the digits
+ *           of its blocks, the counts are turned into a start
+ *           position per block and digit, and each worker
+ *           moves its blocks' keys to their positions. A pass
+ *           in which every key has the same digit is skipped.
+ *   unique  the same split: each block counts the keys that
+ *           differ from the one before, and then copies them
+ *           to their place, as the tree holds no duplicates.
+ *   build   the middle key becomes the root, and the halves
+ *           on either side become its subtrees, the left one
+ *           spawned as a task. Below BUILD_CUTOFF keys a
+ *           subtree is built on one thread.
+ *
+ * Each step does O(n / workers) work per worker, with only
+ * the per-block counts done on one thread, so the build
+ * scales with the number of cores until memory bandwidth
+ * runs out. The nodes come from one allocation, in key
+ * order, instead of one createNode per key. Each subtree's
+ * nodes are first written by the worker that builds it, so
+ * on a NUMA host the pages of the tree end up spread over
+ * the nodes of the workers. The tree is a normal bst.c tree:
+ * find, contains, depth and add work on it.
+ *
+ * containsBatch splits an array of queries across the
+ * workers. Each worker walks LOOKUP_GROUP queries down the
+ * tree together, one level at a time, and prefetches the
+ * next node of each, so their cache misses overlap instead
+ * of following each other.
+ *
+ * bst.c and work-stealing-deque.c are included with their
+ * main() renamed.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#define main bst_main
+#include "bst.c"
+#undef main
+
+#define main work_stealing_deque_main
+#include "../stack/work-stealing-deque.c"
+#undef main
+
+#define DEFAULT_KEYS (1L << 22)
+#define DEFAULT_QUERIES (1L << 22)
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_MIN_BLOCK 16384 // Keys per block, at least.
+#define RADIX_MAX_BLOCKS 256
+#define BUILD_CUTOFF 4096 // Subtrees smaller than this are not split.
+#define LOOKUP_CUTOFF 4096 // Queries per task, at most.
+#define LOOKUP_GROUP 8 // Queries walked together.
+
+typedef struct bulk_tree {
+    node* root; // NULL if there were no keys.
+    node* nodes; // All nodes, in key order.
+    long count; // Distinct keys.
+} bulk_tree;
+
+// The state of the running build or lookup.
+// Tasks only carry two longs, so the arrays
+// they work on are kept here.
+static struct {
+    const int* input;
+    int* keys; // Sorted keys, then unique keys.
+    int* scratch;
+    long count;
+    long blocks;
+    long block_size;
+    int shift; // Of the digit in this radix pass.
+    long (*histograms)[RADIX_BUCKETS]; // One per block.
+    void (*block_work)(long); // Run on each block.
+    node* nodes;
+    const int* queries;
+    unsigned char* results;
+    node* root;
+} bulk;
+
+// Bulk Implementation
+bulk_tree buildBalanced(const int*, long, int);
+void containsBatch(node*, const int*, unsigned char*, long, int);
+void freeBulkTree(bulk_tree*);
+
+// Tasks
+void buildTask(worker*, task*);
+void forEachBlock(worker*, long, void (*)(long));
+void blockTask(worker*, task*);
+void radixSort(worker*);
+long uniqueKeys(worker*);
+void subtreeTask(worker*, task*);
+long buildSubtree(long, long);
+void lookupTask(worker*, task*);
+void lookupGroup(long, long);
+
+// Block Work
+void copyBlock(long);
+void countBlock(long);
+void scatterBlock(long);
+void countUniqueBlock(long);
+void compactBlock(long);
+
+// Helper Function(s)
+unsigned int radixDigit(int);
+void blockRange(long, long*, long*);
+void swapKeys(void);
+uint64_t nextRandom(uint64_t*);
+double secondsSince(struct timespec*);
+
+int main(int argc, char* argv[]) {
+    long key_count = DEFAULT_KEYS;
+    long query_count = DEFAULT_QUERIES;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_workers = cpus < 1 ? 1 : cpus > MAX_WORKERS ? MAX_WORKERS : (int) cpus;
+    int option;
+
+    while ((option = getopt(argc, argv, "n:q:w:")) != -1) {
+        switch (option) {
+            case 'n': key_count = atol(optarg); break;
+            case 'q': query_count = atol(optarg); break;
+            case 'w': max_workers = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-n keys] [-q queries] [-w workers]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (key_count < 1 || query_count < 0 || max_workers < 1 || max_workers > MAX_WORKERS) {
+        fprintf(stderr, "Error: keys must be positive and workers from 1 to %d.\n",
+                MAX_WORKERS);
+        return 1;
+    }
+
+    int* keys = malloc(key_count * sizeof(int));
+    int* queries = malloc((query_count + 1) * sizeof(int));
+    unsigned char* results = malloc(query_count + 1);
+    if (keys == NULL || queries == NULL || results == NULL) {
+        fprintf(stderr, "Error: out of memory.\n");
+        return 1;
+    }
+
+    // Random keys, and queries of which about
+    // half are keys and half are random.
+    uint64_t state = 88172645463325252ull;
+    for (long i = 0; i < key_count; i++)
+        keys[i] = (int) nextRandom(&state);
+    for (long i = 0; i < query_count; i++) {
+        uint64_t random = nextRandom(&state);
+        queries[i] = random & 1 ? keys[(random >> 1) % key_count] : (int) (random >> 32);
+    }
+
+    // The single-threaded way, with add() and contains().
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    node* serial_root = createNode(keys[0]);
+    for (long i = 1; i < key_count; i++)
+        add(serial_root, keys[i]);
+
+    double serial_build = secondsSince(&start);
+    long serial_hits = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (long i = 0; i < query_count; i++)
+        serial_hits += contains(serial_root, queries[i]);
+
+    double serial_lookup = secondsSince(&start);
+
+    printf("%ld keys, %ld queries, %ld hits\n\n", key_count, query_count, serial_hits);
+    printf("%-12s %10s %8s %10s %8s\n", "", "build s", "speedup", "lookup s", "speedup");
+    printf("%-12s %10.3f %8s %10.3f %8s\n", "add/contains", serial_build, "",
+           serial_lookup, "");
+
+    double build_base = 0;
+    double lookup_base = 0;
+
+    // Powers of two, and the largest count
+    // when it is not one.
+    for (int workers = 1; workers <= max_workers;
+         workers = workers < max_workers && workers * 2 > max_workers ? max_workers
+                                                                       : workers * 2) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bulk_tree tree = buildBalanced(keys, key_count, workers);
+        double build = secondsSince(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        containsBatch(tree.root, queries, results, query_count, workers);
+        double lookup = secondsSince(&start);
+
+        if (workers == 1) {
+            build_base = build;
+            lookup_base = lookup;
+        }
+
+        char label[32];
+        snprintf(label, sizeof(label), "%d workers", workers);
+        printf("%-12s %10.3f %8.2f %10.3f %8.2f\n", label, build, build_base / build,
+               lookup, lookup_base / lookup);
+
+        long hits = 0;
+        for (long i = 0; i < query_count; i++)
+            hits += results[i];
+
+        if (hits != serial_hits)
+            printf("Error: %ld hits instead of %ld\n", hits, serial_hits);
+        if (tree.root == NULL || depth(tree.root, tree.nodes[0].value) < 0)
+            printf("Error: smallest key not in tree\n");
+
+        freeBulkTree(&tree);
+    }
+
+    freeTree(serial_root);
+    free(results);
+    free(queries);
+    free(keys);
+
+    return 0;
+}
+
+/*
+ *
+ * Bulk Implementation
+ *
+ */
+
+/// Builds a height-balanced BST holding the distinct
+/// keys, sorting them first.
+/// \param keys in any order, left unchanged
+/// \param count
+/// \param workers threads to use, from 1 to MAX_WORKERS
+/// \return the tree, with a NULL root if count is 0
+/// or out of memory
+bulk_tree buildBalanced(const int* keys, long count, int workers) {
+    bulk_tree tree = {NULL, NULL, 0};
+
+    if (count <= 0)
+        return tree;
+
+    bulk.input = keys;
+    bulk.count = count;
+    bulk.blocks = count / RADIX_MIN_BLOCK;
+    bulk.blocks = bulk.blocks < 1 ? 1 : bulk.blocks > RADIX_MAX_BLOCKS ? RADIX_MAX_BLOCKS
+                                                                       : bulk.blocks;
+    bulk.block_size = (count + bulk.blocks - 1) / bulk.blocks;
+    bulk.keys = malloc(count * sizeof(int));
+    bulk.scratch = malloc(count * sizeof(int));
+    bulk.histograms = malloc(bulk.blocks * sizeof(*bulk.histograms));
+    bulk.nodes = NULL;
+
+    if (bulk.keys != NULL && bulk.scratch != NULL && bulk.histograms != NULL) {
+        task root = {buildTask, 0, 0, -1, 0};
+        runOnScheduler(workers, &root);
+
+        tree.nodes = bulk.nodes;
+        tree.count = tree.nodes != NULL ? root.second : 0;
+        tree.root = root.result >= 0 ? &tree.nodes[root.result] : NULL;
+    }
+
+    free(bulk.histograms);
+    free(bulk.scratch);
+    free(bulk.keys);
+
+    return tree;
+}
+
+/// Sets results[i] to contains(root, queries[i]),
+/// splitting the queries across workers.
+/// \param root
+/// \param queries
+/// \param results one per query
+/// \param count
+/// \param workers threads to use, from 1 to MAX_WORKERS
+void containsBatch(node* root, const int* queries, unsigned char* results, long count,
+                   int workers) {
+    if (count <= 0)
+        return;
+
+    bulk.root = root;
+    bulk.queries = queries;
+    bulk.results = results;
+
+    task all = {lookupTask, 0, count, 0, 0};
+    runOnScheduler(workers, &all);
+}
+
+/// Frees the nodes of a tree from buildBalanced,
+/// and those added later with add(). add() only hangs
+/// new nodes below the tree, so each child outside the
+/// nodes array is the root of an added subtree.
+/// \param tree
+void freeBulkTree(bulk_tree* tree) {
+    uintptr_t first = (uintptr_t) tree->nodes;
+    uintptr_t end = (uintptr_t) (tree->nodes + tree->count);
+
+    for (long i = 0; i < tree->count; i++) {
+        node* children[2] = {tree->nodes[i].left, tree->nodes[i].right};
+
+        for (int j = 0; j < 2; j++) {
+            if (children[j] != NULL
+                && ((uintptr_t) children[j] < first || (uintptr_t) children[j] >= end))
+                freeTree(children[j]);
+        }
+    }
+
+    free(tree->nodes);
+    tree->root = NULL;
+    tree->nodes = NULL;
+    tree->count = 0;
+}
+
+/*
+ *
+ * Tasks
+ *
+ */
+
+/// Sorts, removes duplicates and builds the tree.
+/// Sets second to the number of distinct keys and
+/// result to the index of the root node.
+/// \param self
+/// \param item
+void buildTask(worker* self, task* item) {
+    forEachBlock(self, bulk.blocks, copyBlock);
+    radixSort(self);
+
+    long count = uniqueKeys(self);
+
+    bulk.nodes = malloc(count * sizeof(node));
+    if (bulk.nodes == NULL)
+        return;
+
+    task whole = {subtreeTask, 0, count, -1, 0};
+    subtreeTask(self, &whole);
+
+    item->second = count;
+    item->result = whole.result;
+}
+
+/// Runs work on every block, on all workers, and
+/// returns when all are done.
+/// \param self
+/// \param blocks
+/// \param work
+void forEachBlock(worker* self, long blocks, void (*work)(long)) {
+    bulk.block_work = work;
+
+    task all = {blockTask, 0, blocks, 0, 0};
+    blockTask(self, &all);
+}
+
+/// Runs bulk.block_work on blocks first to second - 1
+/// by splitting the range in half.
+/// \param self
+/// \param item
+void blockTask(worker* self, task* item) {
+    long low = item->first;
+    long high = item->second;
+
+    if (high - low == 1) {
+        bulk.block_work(low);
+        return;
+    }
+
+    long middle = low + (high - low) / 2;
+    task left = {blockTask, low, middle, 0, 0};
+    task right = {blockTask, middle, high, 0, 0};
+
+    spawn(self, &left);
+    blockTask(self, &right);
+    join(self, &left);
+}
+
+/// Sorts bulk.keys, one pass per RADIX_BITS bits.
+/// \param self
+void radixSort(worker* self) {
+    for (bulk.shift = 0; bulk.shift < 32; bulk.shift += RADIX_BITS) {
+        forEachBlock(self, bulk.blocks, countBlock);
+
+        // Turn the counts into the position of the first
+        // key of each digit in each block. Blocks keep
+        // their order within a digit, which makes the
+        // pass stable.
+        long position = 0;
+        int skip = 0;
+
+        for (int digit = 0; digit < RADIX_BUCKETS; digit++) {
+            long start = position;
+
+            for (long block = 0; block < bulk.blocks; block++) {
+                long keys = bulk.histograms[block][digit];
+                bulk.histograms[block][digit] = position;
+                position += keys;
+            }
+
+            if (position - start == bulk.count)
+                skip = 1; // All keys have this digit.
+        }
+
+        if (skip)
+            continue;
+
+        forEachBlock(self, bulk.blocks, scatterBlock);
+        swapKeys();
+    }
+}
+
+/// Moves the distinct keys of the sorted bulk.keys
+/// to its front.
+/// \param self
+/// \return the number of distinct keys
+long uniqueKeys(worker* self) {
+    forEachBlock(self, bulk.blocks, countUniqueBlock);
+
+    long position = 0;
+    for (long block = 0; block < bulk.blocks; block++) {
+        long keys = bulk.histograms[block][0];
+        bulk.histograms[block][0] = position;
+        position += keys;
+    }
+
+    forEachBlock(self, bulk.blocks, compactBlock);
+    swapKeys();
+
+    return position;
+}
+
+/// Builds the subtree of bulk.keys first to second - 1
+/// from bulk.nodes, spawning the left half if it is big.
+/// \param self
+/// \param item receives the index of its root in result,
+/// or -1 if empty
+void subtreeTask(worker* self, task* item) {
+    long low = item->first;
+    long high = item->second;
+
+    if (high - low <= BUILD_CUTOFF) {
+        item->result = buildSubtree(low, high);
+        return;
+    }
+
+    long middle = low + (high - low) / 2;
+    task left = {subtreeTask, low, middle, -1, 0};
+    task right = {subtreeTask, middle + 1, high, -1, 0};
+
+    spawn(self, &left);
+    subtreeTask(self, &right);
+    join(self, &left);
+
+    node* root = &bulk.nodes[middle];
+    root->value = bulk.keys[middle];
+    root->left = left.result >= 0 ? &bulk.nodes[left.result] : NULL;
+    root->right = right.result >= 0 ? &bulk.nodes[right.result] : NULL;
+
+    item->result = middle;
+}
+
+/// Builds the subtree of bulk.keys low to high - 1
+/// on this thread.
+/// \param low
+/// \param high
+/// \return the index of its root, or -1 if empty
+long buildSubtree(long low, long high) {
+    if (low >= high)
+        return -1;
+
+    long middle = low + (high - low) / 2;
+    long left = buildSubtree(low, middle);
+    long right = buildSubtree(middle + 1, high);
+
+    node* root = &bulk.nodes[middle];
+    root->value = bulk.keys[middle];
+    root->left = left >= 0 ? &bulk.nodes[left] : NULL;
+    root->right = right >= 0 ? &bulk.nodes[right] : NULL;
+
+    return middle;
+}
+
+/// Looks up queries first to second - 1, splitting
+/// them in half down to LOOKUP_CUTOFF.
+/// \param self
+/// \param item
+void lookupTask(worker* self, task* item) {
+    long low = item->first;
+    long high = item->second;
+
+    if (high - low <= LOOKUP_CUTOFF) {
+        lookupGroup(low, high);
+        return;
+    }
+
+    long middle = low + (high - low) / 2;
+    task left = {lookupTask, low, middle, 0, 0};
+    task right = {lookupTask, middle, high, 0, 0};
+
+    spawn(self, &left);
+    lookupTask(self, &right);
+    join(self, &left);
+}
+
+/// Looks up queries low to high - 1, LOOKUP_GROUP at
+/// a time, moving each down one level per round.
+/// \param low
+/// \param high
+void lookupGroup(long low, long high) {
+    for (long first = low; first < high; first += LOOKUP_GROUP) {
+        int size = high - first < LOOKUP_GROUP ? (int) (high - first) : LOOKUP_GROUP;
+        node* current[LOOKUP_GROUP];
+        int active = 0;
+
+        for (int i = 0; i < size; i++) {
+            current[i] = bulk.root;
+            bulk.results[first + i] = 0;
+            active += current[i] != NULL;
+        }
+
+        while (active > 0) {
+            active = 0;
+
+            for (int i = 0; i < size; i++) {
+                node* a_node = current[i];
+                if (a_node == NULL)
+                    continue;
+
+                int value = bulk.queries[first + i];
+                if (a_node->value == value) {
+                    bulk.results[first + i] = 1;
+                    current[i] = NULL;
+                    continue;
+                }
+
+                a_node = value < a_node->value ? a_node->left : a_node->right;
+                if (a_node != NULL) {
+                    __builtin_prefetch(a_node);
+                    active++;
+                }
+                current[i] = a_node;
+            }
+        }
+    }
+}
+
+/*
+ *
+ * Block Work
+ *
+ */
+
+/// Copies a block of the input to bulk.keys.
+/// \param block
+void copyBlock(long block) {
+    long low, high;
+    blockRange(block, &low, &high);
+    memcpy(bulk.keys + low, bulk.input + low, (high - low) * sizeof(int));
+}
+
+/// Counts the digits of a block of bulk.keys.
+/// \param block
+void countBlock(long block) {
+    long* histogram = bulk.histograms[block];
+    long low, high;
+    blockRange(block, &low, &high);
+
+    memset(histogram, 0, RADIX_BUCKETS * sizeof(long));
+    for (long i = low; i < high; i++)
+        histogram[radixDigit(bulk.keys[i])]++;
+}
+
+/// Moves the keys of a block of bulk.keys to their
+/// positions in bulk.scratch.
+/// \param block
+void scatterBlock(long block) {
+    long* position = bulk.histograms[block];
+    long low, high;
+    blockRange(block, &low, &high);
+
+    for (long i = low; i < high; i++) {
+        int key = bulk.keys[i];
+        bulk.scratch[position[radixDigit(key)]++] = key;
+    }
+}
+
+/// Counts the keys of a block of the sorted bulk.keys
+/// that differ from the key before them.
+/// \param block
+void countUniqueBlock(long block) {
+    long low, high;
+    long count = 0;
+    blockRange(block, &low, &high);
+
+    for (long i = low; i < high; i++)
+        count += i == 0 || bulk.keys[i] != bulk.keys[i - 1];
+
+    bulk.histograms[block][0] = count;
+}
+
+/// Copies the keys counted by countUniqueBlock to
+/// their positions in bulk.scratch.
+/// \param block
+void compactBlock(long block) {
+    long position = bulk.histograms[block][0];
+    long low, high;
+    blockRange(block, &low, &high);
+
+    for (long i = low; i < high; i++) {
+        if (i == 0 || bulk.keys[i] != bulk.keys[i - 1])
+            bulk.scratch[position++] = bulk.keys[i];
+    }
+}
+
+/*
+ * Helper Function(s)
+ *
+ */
+
+/// Returns the digit of key in this radix pass. The
+/// sign bit is flipped so negative keys sort first.
+/// \param key
+/// \return the digit
+unsigned int radixDigit(int key) {
+    return (((unsigned int) key ^ 0x80000000u) >> bulk.shift) & (RADIX_BUCKETS - 1);
+}
+
+/// Finds the keys of a block.
+/// \param block
+/// \param low receives the first index
+/// \param high receives one past the last index
+void blockRange(long block, long* low, long* high) {
+    *low = block * bulk.block_size;
+    *high = *low + bulk.block_size;
+
+    if (*low > bulk.count)
+        *low = bulk.count;
+    if (*high > bulk.count)
+        *high = bulk.count;
+}
+
+/// Swaps bulk.keys and bulk.scratch after a pass.
+void swapKeys(void) {
+    int* keys = bulk.keys;
+    bulk.keys = bulk.scratch;
+    bulk.scratch = keys;
+}
+
+/// Returns the next number of a xorshift64* generator.
+/// \param state
+/// \return the number
+uint64_t nextRandom(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
+
+/// Returns the seconds elapsed since start.
+/// \param start
+/// \return seconds
+double secondsSince(struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
@@ -0,0 +1,388 @@
+/*
+ *
+ * Double-Ended Queue (Deque)
+ *
+ *    Uses:
+ *      Growable Circular Array (Ring Buffer)
+ *
+ *    Sample Operations:
+ *      pushFront, pushBack, popFront, popBack,
+ *      peekFront, peekBack, get, isEmpty, size,
+ *      pushBackBatch, popFrontBatch, popBackBatch
+ *
+ * Notes:
+ *
+ * stack-using-array.c adds and removes at one end of an
+ * array and queue-using-array.c adds at one end and removes
+ * at the other. A deque does both, at both ends, so one of
+ * them can be used as a stack (pushBack, popBack) and as a
+ * queue (pushBack, popFront) over the same values, without
+ * copying them from one structure into the other.
+ *
+ * The values sit in a circular array, as in queue-using-array.c.
+ * head is the index of the front value and count the number
+ * of values, so the value at position i is at index
+ * (head + i) & mask. The capacity is always a power of two,
+ * so mask = capacity - 1 and wrapping is a single AND
+ * instead of the modulus operator.
+ *
+ * When the array is full the values are copied, unwrapped,
+ * into an array twice the size, like the array stack does.
+ *
+ * The batch functions move many values with at most two
+ * memcpy calls each: one up to the end of the array and one
+ * from its start, where the values wrap around.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_VALUE (-1)
+#define MIN_CAPACITY 16
+
+typedef struct deque {
+    int* arr;
+    size_t capacity; // Size of arr, a power of two.
+    size_t head; // Index of the front value.
+    size_t count; // Number of values.
+} deque;
+
+// Deque Implementation
+int pushFront(deque*, int);
+int pushBack(deque*, int);
+int popFront(deque*);
+int popBack(deque*);
+int peekFront(deque*);
+int peekBack(deque*);
+int get(deque*, size_t);
+int isEmpty(deque*);
+size_t size(deque*);
+size_t pushBackBatch(deque*, const int*, size_t);
+size_t popFrontBatch(deque*, int*, size_t);
+size_t popBackBatch(deque*, int*, size_t);
+
+// Helper Function(s)
+deque* createDeque(void);
+void freeDeque(deque*);
+int reserve(deque*, size_t);
+void copyOut(deque*, size_t, int*, size_t);
+
+int main() {
+    deque* values = createDeque();
+
+    // Peek and pop on empty deque displays
+    // an error and DEFAULT_VALUE.
+    printf("Peek: %d\n", peekFront(values));
+    printf("Pop: %d\n\n", popBack(values));
+
+    // Used as a stack.
+    for (int i = 1; i <= 3; i++)
+        printf("Push: %d\n", pushBack(values, i * 10));
+    while (!isEmpty(values))
+        printf("Pop (LIFO): %d\n", popBack(values));
+
+    printf("\n");
+
+    // Used as a queue.
+    for (int i = 1; i <= 3; i++)
+        printf("Enqueue: %d\n", pushBack(values, i * 10));
+    while (!isEmpty(values))
+        printf("Dequeue (FIFO): %d\n", popFront(values));
+
+    printf("\n");
+
+    // Both ends and random access.
+    pushBack(values, 2);
+    pushBack(values, 3);
+    pushFront(values, 1);
+    pushFront(values, 0);
+
+    printf("Deque:");
+    for (size_t i = 0; i < size(values); i++)
+        printf(" %d", get(values, i));
+    printf("\n\n");
+
+    // Batches wrap around the end of the array.
+    int batch[40];
+    for (int i = 0; i < 40; i++)
+        batch[i] = 100 + i;
+
+    printf("PushBackBatch: %zu\n", pushBackBatch(values, batch, 40));
+    printf("Capacity = %zu\n", values->capacity);
+
+    int out[8];
+    size_t taken = popFrontBatch(values, out, 8);
+    printf("PopFrontBatch:");
+    for (size_t i = 0; i < taken; i++)
+        printf(" %d", out[i]);
+    printf("\n");
+
+    taken = popBackBatch(values, out, 8);
+    printf("PopBackBatch:");
+    for (size_t i = 0; i < taken; i++)
+        printf(" %d", out[i]);
+    printf("\n");
+
+    printf("Size = %zu, Front = %d, Back = %d\n",
+           size(values), peekFront(values), peekBack(values));
+
+    freeDeque(values);
+    values = NULL;
+
+    return 0;
+}
+
+/*
+ *
+ * Deque Implementation
+ *
+ */
+
+/// Adds a value in front of the first value.
+/// \param deque
+/// \param value
+/// \return value added, or DEFAULT_VALUE if out of memory
+int pushFront(deque* deque, int value) {
+    if (!reserve(deque, deque->count + 1)) {
+        printf("Push error! Out of memory.\n");
+        return DEFAULT_VALUE;
+    }
+
+    deque->head = (deque->head - 1) & (deque->capacity - 1);
+    deque->arr[deque->head] = value;
+    deque->count++;
+
+    return value;
+}
+
+/// Adds a value after the last value.
+/// \param deque
+/// \param value
+/// \return value added, or DEFAULT_VALUE if out of memory
+int pushBack(deque* deque, int value) {
+    if (!reserve(deque, deque->count + 1)) {
+        printf("Push error! Out of memory.\n");
+        return DEFAULT_VALUE;
+    }
+
+    deque->arr[(deque->head + deque->count) & (deque->capacity - 1)] = value;
+    deque->count++;
+
+    return value;
+}
+
+/// Returns and removes the first value.
+/// \param deque
+/// \return first value if not empty, otherwise DEFAULT_VALUE
+int popFront(deque* deque) {
+    if (isEmpty(deque)) {
+        printf("Pop error! Deque is empty.\n");
+        return DEFAULT_VALUE;
+    }
+
+    int value = deque->arr[deque->head];
+    deque->head = (deque->head + 1) & (deque->capacity - 1);
+    deque->count--;
+
+    return value;
+}
+
+/// Returns and removes the last value.
+/// \param deque
+/// \return last value if not empty, otherwise DEFAULT_VALUE
+int popBack(deque* deque) {
+    if (isEmpty(deque)) {
+        printf("Pop error! Deque is empty.\n");
+        return DEFAULT_VALUE;
+    }
+
+    deque->count--;
+
+    return deque->arr[(deque->head + deque->count) & (deque->capacity - 1)];
+}
+
+/// Returns the first value.
+/// \param deque
+/// \return first value if not empty, otherwise DEFAULT_VALUE
+int peekFront(deque* deque) {
+    if (isEmpty(deque)) {
+        printf("Peek error! Deque is empty.\n");
+        return DEFAULT_VALUE;
+    }
+
+    return deque->arr[deque->head];
+}
+
+/// Returns the last value.
+/// \param deque
+/// \return last value if not empty, otherwise DEFAULT_VALUE
+int peekBack(deque* deque) {
+    if (isEmpty(deque)) {
+        printf("Peek error! Deque is empty.\n");
+        return DEFAULT_VALUE;
+    }
+
+    return deque->arr[(deque->head + deque->count - 1) & (deque->capacity - 1)];
+}
+
+/// Returns the value at a position, counting
+/// from the front.
+/// \param deque
+/// \param index 0 for the first value
+/// \return the value, or DEFAULT_VALUE if out of range
+int get(deque* deque, size_t index) {
+    if (index >= deque->count) {
+        printf("Get error! Index out of range.\n");
+        return DEFAULT_VALUE;
+    }
+
+    return deque->arr[(deque->head + index) & (deque->capacity - 1)];
+}
+
+/// Checks if the deque is empty.
+/// \param deque
+/// \return 1 if empty, otherwise 0
+int isEmpty(deque* deque) {
+    return deque->count == 0;
+}
+
+/// Returns the number of values in the deque.
+/// \param deque
+/// \return the number of values
+size_t size(deque* deque) {
+    return deque->count;
+}
+
+/// Adds count values after the last value, in order.
+/// \param deque
+/// \param values
+/// \param count
+/// \return count, or 0 if out of memory
+size_t pushBackBatch(deque* deque, const int* values, size_t count) {
+    if (!reserve(deque, deque->count + count)) {
+        printf("Push error! Out of memory.\n");
+        return 0;
+    }
+
+    size_t tail = (deque->head + deque->count) & (deque->capacity - 1);
+    size_t first_part = deque->capacity - tail;
+    if (first_part > count)
+        first_part = count;
+
+    memcpy(&deque->arr[tail], values, first_part * sizeof(int));
+    memcpy(deque->arr, values + first_part, (count - first_part) * sizeof(int));
+    deque->count += count;
+
+    return count;
+}
+
+/// Removes up to count values from the front into
+/// values, first value first.
+/// \param deque
+/// \param values receives the values
+/// \param count
+/// \return the number of values removed
+size_t popFrontBatch(deque* deque, int* values, size_t count) {
+    if (count > deque->count)
+        count = deque->count;
+
+    copyOut(deque, 0, values, count);
+    deque->head = (deque->head + count) & (deque->capacity - 1);
+    deque->count -= count;
+
+    return count;
+}
+
+/// Removes up to count values from the back into
+/// values, last value first, as repeated popBack
+/// calls would return them.
+/// \param deque
+/// \param values receives the values
+/// \param count
+/// \return the number of values removed
+size_t popBackBatch(deque* deque, int* values, size_t count) {
+    if (count > deque->count)
+        count = deque->count;
+
+    copyOut(deque, deque->count - count, values, count);
+    deque->count -= count;
+
+    // Reverse into popBack order.
+    for (size_t i = 0; i < count / 2; i++) {
+        int swap = values[i];
+        values[i] = values[count - 1 - i];
+        values[count - 1 - i] = swap;
+    }
+
+    return count;
+}
+
+/*
+ * Helper Function(s)
+ *
+ */
+
+/// Creates an empty deque.
+/// \return the deque
+deque* createDeque(void) {
+    deque* new_deque = calloc(1, sizeof(deque));
+    new_deque->arr = calloc(MIN_CAPACITY, sizeof(int));
+    new_deque->capacity = MIN_CAPACITY;
+    return new_deque;
+}
+
+/// Frees all memory used by deque.
+/// \param deque
+void freeDeque(deque* deque) {
+    free(deque->arr);
+    free(deque);
+}
+
+/// Makes room for at least count values, doubling
+/// the capacity until they fit. The values are moved
+/// to the start of the new array.
+/// \param deque
+/// \param count
+/// \return 1 if there is room, otherwise 0
+int reserve(deque* deque, size_t count) {
+    if (count <= deque->capacity)
+        return 1;
+
+    size_t capacity = deque->capacity;
+    while (capacity < count) {
+        if (capacity > ((size_t) -1) / 2 / sizeof(int))
+            return 0;
+        capacity *= 2;
+    }
+
+    int* arr = malloc(capacity * sizeof(int));
+    if (arr == NULL)
+        return 0;
+
+    copyOut(deque, 0, arr, deque->count);
+    free(deque->arr);
+
+    deque->arr = arr;
+    deque->capacity = capacity;
+    deque->head = 0;
+
+    return 1;
+}
+
+/// Copies count values starting at position first
+/// into values, with at most two memcpy calls.
+/// \param deque
+/// \param first position counted from the front
+/// \param values
+/// \param count
+void copyOut(deque* deque, size_t first, int* values, size_t count) {
+    size_t start = (deque->head + first) & (deque->capacity - 1);
+    size_t first_part = deque->capacity - start;
+    if (first_part > count)
+        first_part = count;
+
+    memcpy(values, &deque->arr[start], first_part * sizeof(int));
+    memcpy(values + first_part, deque->arr, (count - first_part) * sizeof(int));
+}
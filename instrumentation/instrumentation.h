@@ -0,0 +1,358 @@
+/*
+ *
+ * Instrumentation
+ *
+ *    Uses:
+ *      Per-Thread Counters, Log2 Histograms
+ *
+ *    Sample Operations:
+ *      INSTRUMENT_COUNT, INSTRUMENT_RECORD,
+ *      INSTRUMENT_HIGH_WATER, INSTRUMENT_DUMP,
+ *      instrumentSnapshot, instrumentReset
+ *
+ *    Usage:
+ *      #include "../instrumentation/instrumentation.h"
+ *
+ *      INSTRUMENT_COUNT(bst, add, 1);
+ *      INSTRUMENT_RECORD(bst, find_visited, visited);
+ *      INSTRUMENT_HIGH_WATER(queue, occupancy, size);
+ *      INSTRUMENT_DUMP(stdout);
+ *
+ *    Build:
+ *      gcc -DINSTRUMENT ...          counters and histograms
+ *      gcc -DINSTRUMENT_USDT ...     static tracepoints
+ *
+ * Notes:
+ *
+ * The structures in this repository say nothing about how
+ * they are used: how deep a find goes, how many nodes a
+ * contains scans, how full a queue runs. These macros record
+ * that on the hot paths.
+ *
+ * Without INSTRUMENT and INSTRUMENT_USDT every macro is
+ * ((void) 0) and its arguments are not evaluated, so the
+ * instrumented code compiles exactly as without them.
+ *
+ * A metric is named by a structure and an event, both plain
+ * identifiers, such as (bst, find_visited). There are three
+ * kinds:
+ *
+ *   INSTRUMENT_COUNT       adds an amount to a counter.
+ *   INSTRUMENT_RECORD      adds a value to a histogram with
+ *                          one bucket per power of two, and
+ *                          keeps its count, sum and maximum.
+ *   INSTRUMENT_HIGH_WATER  keeps the largest value seen.
+ *
+ * Each call site looks its metric up by name once and keeps
+ * the id in a static variable. Each thread counts into a
+ * shard of its own, so recording is a few plain loads and
+ * stores with no atomic read-modify-write and no sharing of
+ * cache lines between threads. instrumentSnapshot adds up
+ * the shards of all threads, including threads that exited.
+ *
+ * With INSTRUMENT_USDT every macro also fires a USDT probe
+ * named structure:event with the amount or value as its
+ * argument, for perf or bpftrace, e.g.
+ *
+ *   bpftrace -e 'usdt:./a.out:bst:find_visited
+ *                { @visited = hist(arg0); }'
+ *
+ * A probe that nothing is attached to is a single nop.
+ * INSTRUMENT_USDT needs <sys/sdt.h> (systemtap-sdt-dev).
+ *
+ */
+
+#ifndef INSTRUMENTATION_INSTRUMENTATION_H
+#define INSTRUMENTATION_INSTRUMENTATION_H
+
+#ifdef INSTRUMENT_USDT
+#include <sys/sdt.h>
+#define INSTRUMENT_PROBE_(structure, event, value) \
+    DTRACE_PROBE1(structure, event, (long) (value))
+#else
+#define INSTRUMENT_PROBE_(structure, event, value) ((void) 0)
+#endif
+
+#ifdef INSTRUMENT
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INSTRUMENT_MAX_METRICS 64
+#define INSTRUMENT_BUCKETS 65 // 0, then one per bit length.
+
+typedef enum instrument_kind {
+    INSTRUMENT_COUNTER,
+    INSTRUMENT_HISTOGRAM,
+    INSTRUMENT_HIGH_WATER_MARK
+} instrument_kind;
+
+typedef struct instrument_value {
+    const char* name; // structure.event
+    instrument_kind kind;
+    long count; // Total of a counter, values in a histogram.
+    long sum;
+    long max;
+    long buckets[INSTRUMENT_BUCKETS];
+} instrument_value;
+
+typedef struct instrument_snapshot {
+    int metric_count;
+    instrument_value values[INSTRUMENT_MAX_METRICS];
+} instrument_snapshot;
+
+typedef struct instrument_shard {
+    struct instrument_shard* next; // All shards ever made.
+    instrument_value values[INSTRUMENT_MAX_METRICS];
+} instrument_shard;
+
+static struct {
+    pthread_mutex_t lock; // For registering metrics and shards.
+    int metric_count;
+    const char* names[INSTRUMENT_MAX_METRICS];
+    instrument_kind kinds[INSTRUMENT_MAX_METRICS];
+    instrument_shard* shards;
+} instrument_registry = {PTHREAD_MUTEX_INITIALIZER, 0, {0}, {0}, NULL};
+
+static _Thread_local instrument_shard* instrument_shard_of_thread;
+
+/// Returns the id of a metric, adding it on first use.
+/// \param name
+/// \param kind
+/// \return the id, or INSTRUMENT_MAX_METRICS if there is
+/// no room for another metric
+static inline int instrumentRegister(const char* name, instrument_kind kind) {
+    pthread_mutex_lock(&instrument_registry.lock);
+
+    int id = 0;
+    while (id < instrument_registry.metric_count
+           && strcmp(instrument_registry.names[id], name) != 0)
+        id++;
+
+    if (id == instrument_registry.metric_count && id < INSTRUMENT_MAX_METRICS) {
+        instrument_registry.names[id] = name;
+        instrument_registry.kinds[id] = kind;
+        __atomic_store_n(&instrument_registry.metric_count, id + 1, __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_unlock(&instrument_registry.lock);
+
+    return id;
+}
+
+/// Returns this thread's shard, making it on first use.
+/// \return the shard, or NULL if out of memory
+static inline instrument_shard* instrumentShard(void) {
+    instrument_shard* shard = instrument_shard_of_thread;
+    if (shard != NULL)
+        return shard;
+
+    shard = calloc(1, sizeof(instrument_shard));
+    if (shard == NULL)
+        return NULL;
+
+    pthread_mutex_lock(&instrument_registry.lock);
+    shard->next = instrument_registry.shards;
+    instrument_registry.shards = shard;
+    pthread_mutex_unlock(&instrument_registry.lock);
+
+    instrument_shard_of_thread = shard;
+    return shard;
+}
+
+// Only the owning thread writes a shard, so a relaxed load and
+// store will do. They keep snapshots from other threads free of
+// data races without a locked add.
+#define INSTRUMENT_ADD_(field, amount) \
+    __atomic_store_n(&(field), __atomic_load_n(&(field), __ATOMIC_RELAXED) + (amount), \
+                     __ATOMIC_RELAXED)
+
+/// Adds an amount to a counter.
+/// \param id
+/// \param amount
+static inline void instrumentCount(int id, long amount) {
+    instrument_shard* shard = instrumentShard();
+    if (shard == NULL || id >= INSTRUMENT_MAX_METRICS)
+        return;
+
+    INSTRUMENT_ADD_(shard->values[id].count, amount);
+}
+
+/// Adds a value to a histogram.
+/// \param id
+/// \param value
+static inline void instrumentRecord(int id, long value) {
+    instrument_shard* shard = instrumentShard();
+    if (shard == NULL || id >= INSTRUMENT_MAX_METRICS)
+        return;
+
+    instrument_value* metric = &shard->values[id];
+    unsigned long bits = value > 0 ? (unsigned long) value : 0;
+    int bucket = bits ? 64 - __builtin_clzl(bits) : 0;
+
+    INSTRUMENT_ADD_(metric->count, 1);
+    INSTRUMENT_ADD_(metric->sum, value);
+    INSTRUMENT_ADD_(metric->buckets[bucket], 1);
+    if (value > metric->max)
+        __atomic_store_n(&metric->max, value, __ATOMIC_RELAXED);
+}
+
+/// Raises a high-water mark to value.
+/// \param id
+/// \param value
+static inline void instrumentHighWater(int id, long value) {
+    instrument_shard* shard = instrumentShard();
+    if (shard == NULL || id >= INSTRUMENT_MAX_METRICS)
+        return;
+
+    if (value > shard->values[id].max)
+        __atomic_store_n(&shard->values[id].max, value, __ATOMIC_RELAXED);
+}
+
+/// Adds up the shards of all threads.
+/// \param snapshot receives the totals
+static inline void instrumentSnapshot(instrument_snapshot* snapshot) {
+    memset(snapshot, 0, sizeof(instrument_snapshot));
+
+    pthread_mutex_lock(&instrument_registry.lock);
+
+    snapshot->metric_count = instrument_registry.metric_count;
+    for (int id = 0; id < snapshot->metric_count; id++) {
+        snapshot->values[id].name = instrument_registry.names[id];
+        snapshot->values[id].kind = instrument_registry.kinds[id];
+    }
+
+    for (instrument_shard* shard = instrument_registry.shards; shard != NULL; shard = shard->next) {
+        for (int id = 0; id < snapshot->metric_count; id++) {
+            instrument_value* total = &snapshot->values[id];
+            instrument_value* part = &shard->values[id];
+
+            total->count += __atomic_load_n(&part->count, __ATOMIC_RELAXED);
+            total->sum += __atomic_load_n(&part->sum, __ATOMIC_RELAXED);
+
+            long max = __atomic_load_n(&part->max, __ATOMIC_RELAXED);
+            if (max > total->max)
+                total->max = max;
+
+            for (int i = 0; i < INSTRUMENT_BUCKETS; i++)
+                total->buckets[i] += __atomic_load_n(&part->buckets[i], __ATOMIC_RELAXED);
+        }
+    }
+
+    pthread_mutex_unlock(&instrument_registry.lock);
+}
+
+/// Estimates a percentile of a histogram as the upper
+/// bound of the bucket it falls in.
+/// \param value a histogram from a snapshot
+/// \param percentile from 0 to 100
+/// \return the estimate, at most the maximum seen
+static inline long instrumentPercentile(const instrument_value* value, double percentile) {
+    long rank = (long) (value->count * percentile / 100.0);
+    long seen = 0;
+
+    for (int i = 0; i < INSTRUMENT_BUCKETS; i++) {
+        seen += value->buckets[i];
+        if (seen > rank) {
+            long bound = i >= 63 ? value->max : (1l << i) - 1;
+            return bound < value->max ? bound : value->max;
+        }
+    }
+
+    return value->max;
+}
+
+/// Sets every metric of every thread back to zero.
+/// Counts recorded at the same time may be lost.
+static inline void instrumentReset(void) {
+    pthread_mutex_lock(&instrument_registry.lock);
+    for (instrument_shard* shard = instrument_registry.shards; shard != NULL; shard = shard->next)
+        memset(shard->values, 0, sizeof(shard->values));
+    pthread_mutex_unlock(&instrument_registry.lock);
+}
+
+/// Prints a snapshot of all metrics, one per line.
+/// \param file
+static inline void instrumentDump(FILE* file) {
+    instrument_snapshot* snapshot = malloc(sizeof(instrument_snapshot));
+    if (snapshot == NULL)
+        return;
+
+    instrumentSnapshot(snapshot);
+
+    fprintf(file, "%-28s %12s %10s %8s %8s %8s\n",
+            "metric", "count", "mean", "p50", "p99", "max");
+
+    for (int id = 0; id < snapshot->metric_count; id++) {
+        instrument_value* value = &snapshot->values[id];
+
+        switch (value->kind) {
+            case INSTRUMENT_COUNTER:
+                fprintf(file, "%-28s %12ld\n", value->name, value->count);
+                break;
+
+            case INSTRUMENT_HISTOGRAM:
+                fprintf(file, "%-28s %12ld %10.2f %8ld %8ld %8ld\n", value->name, value->count,
+                        value->count ? (double) value->sum / value->count : 0,
+                        instrumentPercentile(value, 50), instrumentPercentile(value, 99),
+                        value->max);
+                break;
+
+            case INSTRUMENT_HIGH_WATER_MARK:
+                fprintf(file, "%-28s %12s %10s %8s %8s %8ld\n", value->name,
+                        "", "", "", "", value->max);
+                break;
+        }
+    }
+
+    free(snapshot);
+}
+
+// Looks the metric up once per call site.
+#define INSTRUMENT_ID_(structure, event, kind)                                  \
+    static int instrument_site_id = -1;                                         \
+    int instrument_id = __atomic_load_n(&instrument_site_id, __ATOMIC_RELAXED); \
+    if (instrument_id < 0) {                                                    \
+        instrument_id = instrumentRegister(#structure "." #event, kind);        \
+        __atomic_store_n(&instrument_site_id, instrument_id, __ATOMIC_RELAXED); \
+    }
+
+#define INSTRUMENT_COUNT(structure, event, amount) do {                         \
+    INSTRUMENT_ID_(structure, event, INSTRUMENT_COUNTER)                        \
+    instrumentCount(instrument_id, (long) (amount));                            \
+    INSTRUMENT_PROBE_(structure, event, amount);                                \
+} while (0)
+
+#define INSTRUMENT_RECORD(structure, event, value) do {                         \
+    INSTRUMENT_ID_(structure, event, INSTRUMENT_HISTOGRAM)                      \
+    instrumentRecord(instrument_id, (long) (value));                            \
+    INSTRUMENT_PROBE_(structure, event, value);                                 \
+} while (0)
+
+#define INSTRUMENT_HIGH_WATER(structure, event, value) do {                     \
+    INSTRUMENT_ID_(structure, event, INSTRUMENT_HIGH_WATER_MARK)                \
+    instrumentHighWater(instrument_id, (long) (value));                         \
+    INSTRUMENT_PROBE_(structure, event, value);                                 \
+} while (0)
+
+#define INSTRUMENT_DUMP(file) instrumentDump(file)
+
+#elif defined(INSTRUMENT_USDT)
+
+#define INSTRUMENT_COUNT(structure, event, amount) INSTRUMENT_PROBE_(structure, event, amount)
+#define INSTRUMENT_RECORD(structure, event, value) INSTRUMENT_PROBE_(structure, event, value)
+#define INSTRUMENT_HIGH_WATER(structure, event, value) INSTRUMENT_PROBE_(structure, event, value)
+#define INSTRUMENT_DUMP(file) ((void) 0)
+
+#else
+
+#define INSTRUMENT_COUNT(structure, event, amount) ((void) 0)
+#define INSTRUMENT_RECORD(structure, event, value) ((void) 0)
+#define INSTRUMENT_HIGH_WATER(structure, event, value) ((void) 0)
+#define INSTRUMENT_DUMP(file) ((void) 0)
+
+#endif
+
+#endif
@@ -5,11 +5,18 @@
  *    Sample Operations:
  *      add, delete, contains, isEmpty, clear
  *
+ *    Instrumentation (-DINSTRUMENT):
+ *      linked_list.contains_scanned,
+ *      linked_list.delete_scanned, linked_list.nodes
+ *
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "../allocator/slab-allocator.h"
+#include "../instrumentation/instrumentation.h"
+
 typedef struct node {
     int value;
     struct node* next;
@@ -81,6 +88,8 @@ int main() {
     printf("IsEmpty? %s\n\n",
            isEmpty(&list) ? "Yes" : "No" );
 
+    INSTRUMENT_DUMP(stdout);
+
     return 0;
 }
 
@@ -94,16 +103,17 @@ int main() {
 /// \param list
 /// \param value
 int add(linked_list* list, int value) {
-    node* node = calloc(1, sizeof(node));
-    node->value = value;
-    node->next = NULL;
+    node* new_node = slabCalloc(sizeof(node));
+    new_node->value = value;
+    new_node->next = NULL;
+    INSTRUMENT_COUNT(linked_list, nodes, 1);
 
     if (isEmpty(list)) {
-        list->head = node;
-        list->tail = node;
+        list->head = new_node;
+        list->tail = new_node;
     } else {
-        list->tail->next = node;
-        list->tail = node;
+        list->tail->next = new_node;
+        list->tail = new_node;
     }
 
     return value;
@@ -118,8 +128,10 @@ int delete(linked_list* list, int value) {
 
     node* previous_node = NULL;
     node* current_node = list->head;
+    int scanned = 0;
 
     while (current_node != NULL) {
+        scanned++;
         if (current_node->value == value)
             break;
 
@@ -127,6 +139,8 @@ int delete(linked_list* list, int value) {
         current_node = current_node->next;
     }
 
+    INSTRUMENT_RECORD(linked_list, delete_scanned, scanned);
+
     if (current_node != NULL) {
 
         // Deleting the only node in list.
@@ -151,7 +165,8 @@ int delete(linked_list* list, int value) {
             previous_node->next = current_node->next;
         }
 
-        free (current_node);
+        slabFree(current_node, sizeof(node));
+        INSTRUMENT_COUNT(linked_list, nodes, -1);
         return_value = 1;
     }
 
@@ -164,14 +179,18 @@ int delete(linked_list* list, int value) {
 /// \return 1 if value found in list, otherwise 0
 int contains(linked_list* list, int value) {
     node* current_node = list->head;
+    int scanned = 0;
 
     while(current_node != NULL) {
+        scanned++;
         if (current_node->value == value)
             break;
 
         current_node = current_node->next;
     }
 
+    INSTRUMENT_RECORD(linked_list, contains_scanned, scanned);
+
     return current_node == NULL ? 0 : 1;
 }
 
@@ -194,7 +213,7 @@ int clear(linked_list* list) {
     while (current_node != NULL) {
         next_node = current_node->next;
 
-        free(current_node);
+        slabFree(current_node, sizeof(node));
         count_nodes_deleted++;
 
         current_node = next_node;
@@ -203,6 +222,8 @@ int clear(linked_list* list) {
     list->head = NULL;
     list->tail = NULL;
 
+    INSTRUMENT_COUNT(linked_list, nodes, -count_nodes_deleted);
+
     return count_nodes_deleted;
 }
 
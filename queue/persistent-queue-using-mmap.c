@@ -0,0 +1,629 @@
+/*
+ *
+ * Persistent Queue
+ *
+ *   Uses:
+ *      Array backed by a memory-mapped file
+ *
+ *   Sample Operations:
+ *      enqueue, dequeue, isEmpty, isFull, syncQueue, syncFailed
+ *
+ * Notes:
+ *
+ * This is the circular array queue from queue-using-array.c
+ * with its array living in a file instead of on the heap.
+ * The head and tail indexes follow the same rules: both are
+ * -1 when the queue is empty, and they wrap around using the
+ * modulus operator.
+ *
+ * File layout:
+ *
+ *   [ header page ][ capacity * sizeof(int) values ]
+ *
+ * The header page holds the capacity and two commit records.
+ * A commit record is the head and tail indexes at the time of
+ * the last sync, a sequence number and a checksum. Commits
+ * alternate between the two records, so a crash while one
+ * record is being written leaves the other one intact. On
+ * open the valid record with the highest sequence number
+ * wins, and the queue contains exactly the items that were
+ * in it at that commit.
+ *
+ * The working head and tail live in the queue struct, not in
+ * the file. The kernel may write dirty pages back at any time,
+ * so only values that are already durable are ever stored in
+ * the header. A sync first flushes the values written since
+ * the last sync, then writes and flushes the new commit record.
+ *
+ * A dequeue does not free its slot until the next commit,
+ * because after a crash the last commit still owns it. If an
+ * enqueue is about to write into a slot the last commit still
+ * owns, it syncs first.
+ *
+ * How often to sync is chosen when the queue is opened:
+ *
+ *   SYNC_EVERY_OP      every enqueue and dequeue is durable
+ *                      before it returns.
+ *   SYNC_EVERY_N_OPS   sync after every sync_interval ops.
+ *   SYNC_EVERY_T_MS    sync on the first op that comes at
+ *                      least sync_interval ms after the last
+ *                      sync. There is no background thread.
+ *   SYNC_MANUAL        only syncQueue and closeQueue sync.
+ *
+ * Ops done since the last sync are lost on a crash.
+ *
+ * A sync that enqueue or dequeue does because the mode says
+ * it is due may fail. The op has happened by then, so it
+ * still returns its value, and syncFailed reports the
+ * failure until a later sync succeeds.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <libgen.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ERROR_RETURN_VALUE (-1)
+#define HEADER_SIZE 4096
+#define QUEUE_MAGIC 0x51554555u // "QUEU"
+#define QUEUE_VERSION 1
+
+typedef enum sync_mode {
+    SYNC_EVERY_OP,
+    SYNC_EVERY_N_OPS,
+    SYNC_EVERY_T_MS,
+    SYNC_MANUAL
+} sync_mode;
+
+typedef struct commit_record {
+    uint64_t sequence;
+    int32_t head;
+    int32_t tail;
+    uint32_t checksum;
+    uint32_t padding;
+} commit_record;
+
+typedef struct queue_header {
+    uint32_t magic;
+    uint32_t version;
+    int32_t capacity;
+    uint32_t padding;
+    commit_record records[2];
+} queue_header;
+
+typedef struct queue {
+    int fd;
+    char* map; // The whole file.
+    size_t map_size;
+    queue_header* header; // Start of map.
+    int* arr; // Values, right after the header page.
+    int capacity; // Maximum size of array
+    int head; // Index pointing to the head of queue.
+    int tail; // Index pointing to the tail of queue.
+    int committed_head; // Head as of the last sync.
+    int committed_tail; // Tail as of the last sync.
+    uint64_t sequence; // Sequence number of the last sync.
+    int dirty_low; // Lowest slot written since the last sync.
+    int dirty_high; // Highest slot written since the last sync.
+    sync_mode mode;
+    long sync_interval; // Ops or ms, depending on mode.
+    long ops_since_sync;
+    int sync_failed; // 1 if a due sync failed since the last good one.
+    struct timespec last_sync;
+} queue;
+
+// Queue Implementation
+int enqueue(queue*, int);
+int dequeue(queue*);
+int isEmpty(queue*);
+int isFull(queue*);
+int syncQueue(queue*);
+int syncFailed(queue*);
+
+// Helper Function(s)
+queue* openQueue(const char*, int, sync_mode, long);
+int closeQueue(queue*);
+void abandonQueue(queue*);
+int ownedByCommit(queue*, int);
+void afterOperation(queue*);
+int syncDirectory(const char*);
+uint32_t checksumRecord(const commit_record*);
+double benchmark(const char*, sync_mode, long, int);
+double secondsSince(const struct timespec*);
+
+int main(int argc, char* argv[]) {
+    const char* path = argc > 1 ? argv[1] : "persistent-queue.dat";
+    unlink(path);
+
+    // Enqueue some values and make them durable.
+    queue* que = openQueue(path, 10, SYNC_EVERY_N_OPS, 100);
+    if (que == NULL)
+        return 1;
+
+    for (int i = 0; i < 5; i++)
+        printf("Enqueue: %d\n", enqueue(que, i));
+
+    syncQueue(que);
+    printf("Sync\n");
+
+    // These are not synced before the "crash".
+    printf("Dequeue: %d\n", dequeue(que));
+    printf("Enqueue: %d\n", enqueue(que, 5));
+    printf("Enqueue: %d\n", enqueue(que, 6));
+
+    // Drop the queue as a crashed process would.
+    printf("Crash\n\n");
+    abandonQueue(que);
+
+    // Reopen the file. Exactly the synced values are back.
+    que = openQueue(path, 10, SYNC_EVERY_OP, 0);
+    if (que == NULL)
+        return 1;
+
+    while (!isEmpty(que)) {
+        printf("Dequeue: %d\n", dequeue(que));
+    }
+
+    closeQueue(que);
+    unlink(path);
+
+    printf("\n");
+
+    // Throughput at each durability level. Every
+    // op is an enqueue followed later by a dequeue.
+    printf("%-20s %12s\n", "Durability", "ops/s");
+    printf("%-20s %12.0f\n", "every op",
+           benchmark(path, SYNC_EVERY_OP, 0, 2000));
+    printf("%-20s %12.0f\n", "every 64 ops",
+           benchmark(path, SYNC_EVERY_N_OPS, 64, 100000));
+    printf("%-20s %12.0f\n", "every 1024 ops",
+           benchmark(path, SYNC_EVERY_N_OPS, 1024, 1000000));
+    printf("%-20s %12.0f\n", "every 10 ms",
+           benchmark(path, SYNC_EVERY_T_MS, 10, 1000000));
+    printf("%-20s %12.0f\n", "manual (on close)",
+           benchmark(path, SYNC_MANUAL, 0, 1000000));
+
+    return 0;
+}
+
+/*
+ *
+ * Queue Implementation
+ *
+ */
+
+/// Adds a value to the back of the queue. If the
+/// queue is full it displays an error message and
+/// returns ERROR_RETURN_VALUE, otherwise it returns
+/// the value added to the queue.
+/// \param que
+/// \param value
+/// \return ERROR_RETURN_VALUE if full or the sync
+/// needed to free the slot failed, and nothing is
+/// added, otherwise value. A failed sync after
+/// adding it is reported by syncFailed.
+int enqueue(queue* que, int value) {
+    if (isFull(que)) {
+        printf("Error: Queue is full.\n");
+        return ERROR_RETURN_VALUE;
+    }
+
+    int tail = (que->tail + 1) % que->capacity;
+
+    // The last commit still holds a value in this
+    // slot. Commit the dequeues that freed it before
+    // writing over it.
+    if (ownedByCommit(que, tail)) {
+        if (syncQueue(que) == ERROR_RETURN_VALUE)
+            return ERROR_RETURN_VALUE;
+    }
+
+    que->tail = tail;
+
+    // If this is the first item in the queue,
+    // set the head index to this first item.
+    if (que->head == -1)
+        que->head = 0;
+
+    que->arr[que->tail] = value;
+
+    if (que->dirty_low == -1 || tail < que->dirty_low)
+        que->dirty_low = tail;
+    if (tail > que->dirty_high)
+        que->dirty_high = tail;
+
+    afterOperation(que);
+
+    return value;
+}
+
+/// Returns and removes the value at the front of the
+/// queue. If the queue is empty it displays an error
+/// message and returns ERROR_RETURN_VALUE.
+/// \param que
+/// \return ERROR_RETURN_VALUE if empty, otherwise
+/// value. A failed sync after removing it is
+/// reported by syncFailed.
+int dequeue(queue* que) {
+    if (isEmpty(que)) {
+        printf("Error: Queue is empty.\n");
+        return ERROR_RETURN_VALUE;
+    }
+
+    int value = que->arr[que->head];
+
+    // If head == tail, and they don't
+    // equal -1, this is the last item
+    // in the queue, set it to empty.
+    if (que->head == que->tail) {
+        que->head = -1;
+        que->tail = -1;
+    } else {
+        que->head++;
+        que->head = que->head % que->capacity;
+    }
+
+    afterOperation(que);
+
+    return value;
+}
+
+/// Checks if the queue is empty.
+/// \param que
+/// \return 1 if empty, otherwise 0
+int isEmpty(queue* que) {
+    return que->head == -1;
+}
+
+/// Checks if the queue is full.
+/// \param que
+/// \return 1 if full, otherwise 0
+int isFull(queue* que) {
+    // A queue is full when the tail index is
+    // one less than the head index.
+    return (que->tail + 1) % que->capacity == que->head;
+}
+
+/// Makes every enqueue and dequeue done so far durable.
+/// The values written since the last sync are flushed
+/// first, then the new head and tail are written to the
+/// older of the two commit records and flushed.
+/// \param que
+/// \return 0 on success, otherwise ERROR_RETURN_VALUE
+int syncQueue(queue* que) {
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    if (que->dirty_low != -1) {
+        char* start = (char*) &que->arr[que->dirty_low];
+        char* end = (char*) &que->arr[que->dirty_high + 1];
+
+        // msync wants a page aligned address.
+        char* aligned = que->map + ((start - que->map) / page_size) * page_size;
+
+        if (msync(aligned, end - aligned, MS_SYNC) != 0) {
+            perror("Error: msync values");
+            return ERROR_RETURN_VALUE;
+        }
+
+        que->dirty_low = -1;
+        que->dirty_high = -1;
+    }
+
+    commit_record* record = &que->header->records[(que->sequence + 1) % 2];
+    record->sequence = que->sequence + 1;
+    record->head = que->head;
+    record->tail = que->tail;
+    record->checksum = checksumRecord(record);
+
+    if (msync(que->map, HEADER_SIZE, MS_SYNC) != 0) {
+        perror("Error: msync header");
+        return ERROR_RETURN_VALUE;
+    }
+
+    que->sequence++;
+    que->committed_head = que->head;
+    que->committed_tail = que->tail;
+    que->ops_since_sync = 0;
+    que->sync_failed = 0;
+    clock_gettime(CLOCK_MONOTONIC, &que->last_sync);
+
+    return 0;
+}
+
+/// Checks if a sync done by enqueue or dequeue failed,
+/// so their ops since the last good sync are not
+/// durable. Call syncQueue to try again.
+/// \param que
+/// \return 1 if it failed, otherwise 0
+int syncFailed(queue* que) {
+    return que->sync_failed;
+}
+
+/*
+ * Helper Function(s)
+ *
+ */
+
+/// Opens the queue stored in the file at path. A new
+/// file is created if it does not exist, otherwise the
+/// queue is recovered from the last commit in the file
+/// and capacity is ignored.
+/// \param path
+/// \param capacity the maximum number of items in a new
+/// queue, at least 1
+/// \param mode how often to sync
+/// \param sync_interval ops or ms between syncs, see mode
+/// \return the queue, or NULL on error
+queue* openQueue(const char* path, int capacity, sync_mode mode, long sync_interval) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        perror("Error: open");
+        return NULL;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        perror("Error: fstat");
+        close(fd);
+        return NULL;
+    }
+
+    int is_new = file_stat.st_size == 0;
+
+    if (is_new && capacity < 1) {
+        printf("Error: capacity must be at least 1.\n");
+        close(fd);
+        return NULL;
+    }
+
+    if (!is_new) {
+        // Read the capacity before mapping the whole file.
+        queue_header stored;
+        if (pread(fd, &stored, sizeof(stored), 0) != sizeof(stored)
+            || stored.magic != QUEUE_MAGIC
+            || stored.version != QUEUE_VERSION
+            || stored.capacity <= 0) {
+            printf("Error: %s is not a queue file.\n", path);
+            close(fd);
+            return NULL;
+        }
+        capacity = stored.capacity;
+    }
+
+    size_t map_size = HEADER_SIZE + (size_t) capacity * sizeof(int);
+
+    if (is_new || (size_t) file_stat.st_size < map_size) {
+        if (ftruncate(fd, map_size) != 0) {
+            perror("Error: ftruncate");
+            close(fd);
+            return NULL;
+        }
+    }
+
+    char* map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("Error: mmap");
+        close(fd);
+        return NULL;
+    }
+
+    queue* que = calloc(1, sizeof(queue));
+    que->fd = fd;
+    que->map = map;
+    que->map_size = map_size;
+    que->header = (queue_header*) map;
+    que->arr = (int*) (map + HEADER_SIZE);
+    que->capacity = capacity;
+    que->mode = mode;
+    que->sync_interval = sync_interval;
+    que->dirty_low = -1;
+    que->dirty_high = -1;
+
+    if (is_new) {
+        que->header->magic = QUEUE_MAGIC;
+        que->header->version = QUEUE_VERSION;
+        que->header->capacity = capacity;
+        que->head = -1;
+        que->tail = -1;
+        que->sequence = 0;
+
+        // Commit the empty queue, and the directory
+        // entry of the new file, so a crash right
+        // after creating the file can be recovered.
+        if (syncQueue(que) != 0 || syncDirectory(path) != 0) {
+            closeQueue(que);
+            return NULL;
+        }
+    } else {
+        // Use the newest record that is not torn.
+        commit_record* newest = NULL;
+        for (int i = 0; i < 2; i++) {
+            commit_record* record = &que->header->records[i];
+            if (record->checksum != checksumRecord(record))
+                continue;
+            if (newest == NULL || record->sequence > newest->sequence)
+                newest = record;
+        }
+
+        if (newest == NULL
+            || newest->head < -1 || newest->head >= capacity
+            || newest->tail < -1 || newest->tail >= capacity
+            || (newest->head == -1) != (newest->tail == -1)) {
+            printf("Error: %s has no valid commit.\n", path);
+            munmap(map, map_size);
+            close(fd);
+            free(que);
+            return NULL;
+        }
+
+        que->head = newest->head;
+        que->tail = newest->tail;
+        que->sequence = newest->sequence;
+        que->committed_head = que->head;
+        que->committed_tail = que->tail;
+        clock_gettime(CLOCK_MONOTONIC, &que->last_sync);
+    }
+
+    return que;
+}
+
+/// Syncs the queue and frees all memory used by que.
+/// \param que
+/// \return 0 on success, otherwise ERROR_RETURN_VALUE
+int closeQueue(queue* que) {
+    int result = syncQueue(que);
+
+    munmap(que->map, que->map_size);
+    close(que->fd);
+    free(que);
+
+    return result;
+}
+
+/// Frees que without syncing, losing every op done
+/// since the last sync as a crash would.
+/// \param que
+void abandonQueue(queue* que) {
+    munmap(que->map, que->map_size);
+    close(que->fd);
+    free(que);
+}
+
+/// Checks if the last commit holds a value in slot.
+/// \param que
+/// \param slot
+/// \return 1 if slot is in use by the last commit, otherwise 0
+int ownedByCommit(queue* que, int slot) {
+    int head = que->committed_head;
+    int tail = que->committed_tail;
+
+    if (head == -1)
+        return 0;
+
+    // The committed items may wrap around
+    // the end of the array.
+    if (head <= tail)
+        return slot >= head && slot <= tail;
+    else
+        return slot >= head || slot <= tail;
+}
+
+/// Syncs the queue if its sync mode says it is time,
+/// and notes a failed sync for syncFailed.
+/// \param que
+void afterOperation(queue* que) {
+    int due = 0;
+
+    que->ops_since_sync++;
+
+    switch (que->mode) {
+        case SYNC_EVERY_OP:
+            due = 1;
+            break;
+        case SYNC_EVERY_N_OPS:
+            due = que->ops_since_sync >= que->sync_interval;
+            break;
+        case SYNC_EVERY_T_MS:
+            due = secondsSince(&que->last_sync) * 1000 >= que->sync_interval;
+            break;
+        case SYNC_MANUAL:
+            break;
+    }
+
+    if (due && syncQueue(que) == ERROR_RETURN_VALUE)
+        que->sync_failed = 1;
+}
+
+/// Flushes the directory holding path, so a file
+/// just created there survives a crash.
+/// \param path
+/// \return 0 on success, otherwise ERROR_RETURN_VALUE
+int syncDirectory(const char* path) {
+    char* copy = strdup(path);
+    if (copy == NULL)
+        return ERROR_RETURN_VALUE;
+
+    int fd = open(dirname(copy), O_RDONLY | O_DIRECTORY);
+    free(copy);
+    if (fd == -1) {
+        perror("Error: open directory");
+        return ERROR_RETURN_VALUE;
+    }
+
+    int result = fsync(fd) == 0 ? 0 : ERROR_RETURN_VALUE;
+    if (result != 0)
+        perror("Error: fsync directory");
+
+    close(fd);
+    return result;
+}
+
+/// FNV-1a hash of a commit record, not counting
+/// the checksum field itself.
+/// \param record
+/// \return the checksum
+uint32_t checksumRecord(const commit_record* record) {
+    const unsigned char* bytes = (const unsigned char*) record;
+    size_t length = offsetof(commit_record, checksum);
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/// Runs ops enqueues and ops dequeues through a new
+/// queue file, keeping the queue about half full.
+/// \param path
+/// \param mode
+/// \param sync_interval
+/// \param ops number of enqueues
+/// \return ops per second, counting enqueues and dequeues
+double benchmark(const char* path, sync_mode mode, long sync_interval, int ops) {
+    unlink(path);
+
+    queue* que = openQueue(path, 4096, mode, sync_interval);
+    if (que == NULL)
+        return 0;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int i = 0; i < ops; i++) {
+        enqueue(que, i);
+        if (i >= 2048)
+            dequeue(que);
+    }
+    while (!isEmpty(que))
+        dequeue(que);
+
+    closeQueue(que);
+    double seconds = secondsSince(&start);
+
+    unlink(path);
+
+    return 2.0 * ops / seconds;
+}
+
+/// Returns the seconds elapsed since start.
+/// \param start a CLOCK_MONOTONIC time
+/// \return elapsed seconds
+double secondsSince(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
@@ -0,0 +1,447 @@
+/*
+ *
+ * Priority Queue
+ *
+ *   Uses:
+ *      Array (4-ary Min-Heap)
+ *
+ *   Sample Operations:
+ *      enqueue, dequeue, peek, isEmpty, isFull,
+ *      decreaseKey, enqueueBatch, heapify
+ *
+ * Notes:
+ *
+ * Items leave the queue lowest priority number first,
+ * unlike the FIFO queues next to this file. Both enqueue
+ * and dequeue are O(log n) instead of the O(n) insert
+ * into a sorted linked list.
+ *
+ * The heap is stored in an array. Every node has HEAP_ARITY
+ * children instead of two, so the tree is half as tall as
+ * a binary heap and the children of a node sit next to each
+ * other in memory. A sift-down reads the children from one
+ * or two cache lines and the shorter tree means fewer of
+ * them. With HEAP_ARITY children the node at index i has its
+ * parent at (i - 1) / HEAP_ARITY and its first child at
+ * i * HEAP_ARITY + 1.
+ *
+ * Only the priority and a handle are kept in the heap array,
+ * so the entries moved around by a sift are small. The value
+ * for a handle lives in a separate array that never moves.
+ *
+ * A handle is returned by enqueue and stays valid until the
+ * item is dequeued. It is used with decreaseKey to make an
+ * item more urgent without searching for it. The position
+ * array maps each handle to its current index in the heap.
+ * Unused handles are kept in a free list that is threaded
+ * through the position array.
+ *
+ * heapify builds the queue from arrays in O(n) by sifting
+ * down every parent, from the last one back to the root.
+ * enqueueBatch uses the same idea when the batch is large
+ * compared to the queue, otherwise it sifts each new item up.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ERROR_RETURN_VALUE (-1)
+#define HEAP_ARITY 4
+#define NO_HANDLE (-1)
+
+typedef struct heap_entry {
+    int priority;
+    int handle;
+} heap_entry;
+
+typedef struct priority_queue {
+    heap_entry* heap; // The 4-ary heap ordered by priority.
+    int* values; // Value of each handle.
+    int* position; // Heap index of each handle, or next free handle.
+    int capacity; // Maximum number of items in queue.
+    int size; // Number of items in queue.
+    int free_handle; // Head of the free handle list.
+} priority_queue;
+
+// Priority Queue Implementation
+int enqueue(priority_queue*, int, int);
+int dequeue(priority_queue*);
+int peek(priority_queue*);
+int isEmpty(priority_queue*);
+int isFull(priority_queue*);
+int decreaseKey(priority_queue*, int, int);
+int enqueueBatch(priority_queue*, const int*, const int*, int, int*);
+priority_queue* heapify(const int*, const int*, int, int);
+
+// Helper Function(s)
+priority_queue* createPriorityQueue(int);
+void freePriorityQueue(priority_queue*);
+void siftUp(priority_queue*, int);
+void siftDown(priority_queue*, int);
+void buildHeap(priority_queue*);
+int takeHandle(priority_queue*);
+
+int main() {
+    priority_queue* pq = createPriorityQueue(10);
+
+    // Values are task ids, priorities are
+    // deadlines. Lowest deadline goes first.
+    printf("Enqueue: %d\n", enqueue(pq, 100, 50));
+    printf("Enqueue: %d\n", enqueue(pq, 101, 20));
+    int late_task = enqueue(pq, 102, 90);
+    printf("Enqueue: %d\n", late_task);
+    printf("Enqueue: %d\n", enqueue(pq, 103, 10));
+
+    // The task with handle late_task becomes
+    // the most urgent one.
+    printf("DecreaseKey: %d\n", decreaseKey(pq, late_task, 5));
+
+    int batch_values[] = {104, 105, 106};
+    int batch_priorities[] = {40, 30, 60};
+    printf("EnqueueBatch: %d\n",
+           enqueueBatch(pq, batch_values, batch_priorities, 3, NULL));
+
+    printf("\n");
+
+    while (!isEmpty(pq)) {
+        printf("Dequeue: %d\n", dequeue(pq));
+    }
+
+    freePriorityQueue(pq);
+
+    printf("\n");
+
+    // Build a queue from an unsorted array in O(n).
+    int values[] = {7, 3, 9, 1, 8, 2, 6, 4, 5, 0};
+    pq = heapify(values, values, 10, 10);
+
+    while (!isEmpty(pq)) {
+        printf("Dequeue: %d\n", dequeue(pq));
+    }
+
+    // Free the memory and eliminate
+    // dangling pointer.
+    freePriorityQueue(pq);
+    pq = NULL;
+
+    return 0;
+}
+
+/*
+ *
+ * Priority Queue Implementation
+ *
+ */
+
+/// Adds a value to the queue with the given priority.
+/// Lower priority numbers are dequeued first. If the
+/// queue is full it displays an error message and
+/// returns ERROR_RETURN_VALUE.
+/// \param pq
+/// \param value
+/// \param priority
+/// \return ERROR_RETURN_VALUE if full, otherwise the
+/// handle of the new item
+int enqueue(priority_queue* pq, int value, int priority) {
+    if (isFull(pq)) {
+        printf("Error: Queue is full.\n");
+        return ERROR_RETURN_VALUE;
+    }
+
+    int handle = takeHandle(pq);
+    pq->values[handle] = value;
+
+    int index = pq->size;
+    pq->size++;
+    pq->heap[index].priority = priority;
+    pq->heap[index].handle = handle;
+    pq->position[handle] = index;
+
+    siftUp(pq, index);
+
+    return handle;
+}
+
+/// Returns and removes the value with the lowest
+/// priority number. If the queue is empty it displays
+/// an error message and returns ERROR_RETURN_VALUE.
+/// \param pq
+/// \return ERROR_RETURN_VALUE if empty, otherwise value
+int dequeue(priority_queue* pq) {
+    if (isEmpty(pq)) {
+        printf("Error: Queue is empty.\n");
+        return ERROR_RETURN_VALUE;
+    }
+
+    int handle = pq->heap[0].handle;
+    int value = pq->values[handle];
+
+    // Put the handle back on the free list.
+    pq->position[handle] = pq->free_handle;
+    pq->free_handle = handle;
+
+    // Move the last entry to the root and
+    // let it sink to its place.
+    pq->size--;
+    if (pq->size > 0) {
+        pq->heap[0] = pq->heap[pq->size];
+        pq->position[pq->heap[0].handle] = 0;
+        siftDown(pq, 0);
+    }
+
+    return value;
+}
+
+/// Returns the value with the lowest priority number
+/// without removing it. If the queue is empty it
+/// displays an error message and returns
+/// ERROR_RETURN_VALUE.
+/// \param pq
+/// \return ERROR_RETURN_VALUE if empty, otherwise value
+int peek(priority_queue* pq) {
+    if (isEmpty(pq)) {
+        printf("Error: Queue is empty.\n");
+        return ERROR_RETURN_VALUE;
+    }
+
+    return pq->values[pq->heap[0].handle];
+}
+
+/// Checks if the queue is empty.
+/// \param pq
+/// \return 1 if empty, otherwise 0
+int isEmpty(priority_queue* pq) {
+    return pq->size == 0;
+}
+
+/// Checks if the queue is full.
+/// \param pq
+/// \return 1 if full, otherwise 0
+int isFull(priority_queue* pq) {
+    return pq->size == pq->capacity;
+}
+
+/// Lowers the priority number of a queued item so it
+/// is dequeued sooner. A priority that is not lower
+/// than the current one is an error and is ignored.
+/// \param pq
+/// \param handle returned by enqueue
+/// \param priority the new priority
+/// \return ERROR_RETURN_VALUE on error, otherwise handle
+int decreaseKey(priority_queue* pq, int handle, int priority) {
+    if (handle < 0 || handle >= pq->capacity) {
+        printf("Error: Invalid handle.\n");
+        return ERROR_RETURN_VALUE;
+    }
+
+    int index = pq->position[handle];
+
+    // A free handle holds a free list link, which
+    // may point at a heap slot of another handle.
+    if (index < 0 || index >= pq->size || pq->heap[index].handle != handle) {
+        printf("Error: Invalid handle.\n");
+        return ERROR_RETURN_VALUE;
+    }
+
+    if (priority > pq->heap[index].priority) {
+        printf("Error: Priority is not lower.\n");
+        return ERROR_RETURN_VALUE;
+    }
+
+    pq->heap[index].priority = priority;
+    siftUp(pq, index);
+
+    return handle;
+}
+
+/// Adds count values to the queue at once. Sifting up
+/// each item costs O(count * log n), so when the batch
+/// is large compared to the queue the whole heap is
+/// rebuilt in O(n + count) instead. If the batch does
+/// not fit, or the arguments are invalid, it displays
+/// an error message and nothing is added.
+/// \param pq
+/// \param values
+/// \param priorities
+/// \param count number of items in values and priorities
+/// \param handles receives the handle of each item, may be NULL
+/// \return ERROR_RETURN_VALUE if it does not fit or
+/// the arguments are invalid, otherwise the number of
+/// items added
+int enqueueBatch(priority_queue* pq, const int* values,
+                 const int* priorities, int count, int* handles) {
+    if (count < 0 || (count > 0 && (values == NULL || priorities == NULL))) {
+        printf("Error: Invalid batch.\n");
+        return ERROR_RETURN_VALUE;
+    }
+
+    if (count > pq->capacity - pq->size) {
+        printf("Error: Queue is full.\n");
+        return ERROR_RETURN_VALUE;
+    }
+
+    // Append the new entries without
+    // restoring the heap order yet.
+    int first = pq->size;
+    for (int i = 0; i < count; i++) {
+        int handle = takeHandle(pq);
+        pq->values[handle] = values[i];
+
+        int index = first + i;
+        pq->heap[index].priority = priorities[i];
+        pq->heap[index].handle = handle;
+        pq->position[handle] = index;
+
+        if (handles != NULL)
+            handles[i] = handle;
+    }
+    pq->size += count;
+
+    // A rebuild touches every entry once. Sifting
+    // up only touches the new ones, but walks the
+    // height of the tree for each of them.
+    if (count > first / 8) {
+        buildHeap(pq);
+    } else {
+        for (int i = first; i < pq->size; i++)
+            siftUp(pq, i);
+    }
+
+    return count;
+}
+
+/// Creates a queue from arrays of values and priorities
+/// in O(n). The handle of values[i] is i.
+/// \param values
+/// \param priorities
+/// \param count number of items in values and priorities
+/// \param capacity the maximum number of items in queue
+/// \return the queue, or NULL if count > capacity
+priority_queue* heapify(const int* values, const int* priorities,
+                        int count, int capacity) {
+    if (count > capacity) {
+        printf("Error: Queue is full.\n");
+        return NULL;
+    }
+
+    priority_queue* pq = createPriorityQueue(capacity);
+    enqueueBatch(pq, values, priorities, count, NULL);
+
+    return pq;
+}
+
+/*
+ * Helper Function(s)
+ *
+ */
+
+/// Creates an empty priority queue.
+/// \param capacity the maximum number of items in queue
+/// \return the queue
+priority_queue* createPriorityQueue(int capacity) {
+    priority_queue* pq = calloc(1, sizeof(priority_queue));
+    pq->heap = calloc(capacity, sizeof(heap_entry));
+    pq->values = calloc(capacity, sizeof(int));
+    pq->position = calloc(capacity, sizeof(int));
+    pq->capacity = capacity;
+    pq->size = 0;
+
+    // Every handle starts on the free list,
+    // lowest handle first.
+    for (int i = 0; i < capacity; i++)
+        pq->position[i] = i + 1 < capacity ? i + 1 : NO_HANDLE;
+    pq->free_handle = capacity > 0 ? 0 : NO_HANDLE;
+
+    return pq;
+}
+
+/// Frees all memory used by pq.
+/// \param pq
+void freePriorityQueue(priority_queue* pq) {
+    free(pq->heap);
+    free(pq->values);
+    free(pq->position);
+    free(pq);
+}
+
+/// Moves the entry at index towards the root
+/// until its parent has a lower or equal priority.
+/// \param pq
+/// \param index
+void siftUp(priority_queue* pq, int index) {
+    heap_entry entry = pq->heap[index];
+
+    // Shift parents down into the hole instead
+    // of swapping, then drop the entry in once.
+    while (index > 0) {
+        int parent = (index - 1) / HEAP_ARITY;
+        if (pq->heap[parent].priority <= entry.priority)
+            break;
+
+        pq->heap[index] = pq->heap[parent];
+        pq->position[pq->heap[index].handle] = index;
+        index = parent;
+    }
+
+    pq->heap[index] = entry;
+    pq->position[entry.handle] = index;
+}
+
+/// Moves the entry at index away from the root
+/// until all of its children have a higher or
+/// equal priority.
+/// \param pq
+/// \param index
+void siftDown(priority_queue* pq, int index) {
+    heap_entry entry = pq->heap[index];
+
+    while (1) {
+        int first_child = index * HEAP_ARITY + 1;
+        if (first_child >= pq->size)
+            break;
+
+        int last_child = first_child + HEAP_ARITY;
+        if (last_child > pq->size)
+            last_child = pq->size;
+
+        // Find the child with the lowest priority.
+        int min_child = first_child;
+        for (int child = first_child + 1; child < last_child; child++) {
+            if (pq->heap[child].priority < pq->heap[min_child].priority)
+                min_child = child;
+        }
+
+        if (pq->heap[min_child].priority >= entry.priority)
+            break;
+
+        pq->heap[index] = pq->heap[min_child];
+        pq->position[pq->heap[index].handle] = index;
+        index = min_child;
+    }
+
+    pq->heap[index] = entry;
+    pq->position[entry.handle] = index;
+}
+
+/// Restores the heap order of the whole array in
+/// O(n) by sifting down every parent, starting with
+/// the last one.
+/// \param pq
+void buildHeap(priority_queue* pq) {
+    if (pq->size < 2)
+        return;
+
+    for (int i = (pq->size - 2) / HEAP_ARITY; i >= 0; i--)
+        siftDown(pq, i);
+}
+
+/// Removes a handle from the free list.
+/// The caller makes sure the queue is not full.
+/// \param pq
+/// \return the handle
+int takeHandle(priority_queue* pq) {
+    int handle = pq->free_handle;
+    pq->free_handle = pq->position[handle];
+    return handle;
+}
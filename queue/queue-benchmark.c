@@ -0,0 +1,580 @@
+/*
+ *
+ * Queue Benchmark
+ *
+ *    Measures:
+ *      items/s, enqueue-to-dequeue latency percentiles,
+ *      allocation counts and RSS
+ *
+ *    Options:
+ *      -p producers   producer threads (default 1)
+ *      -c consumers   consumer threads (default 1)
+ *      -b burst       items a producer enqueues before
+ *                     yielding (default 1)
+ *      -q capacity    maximum items in the queue (default 1024)
+ *      -n items       total items to send (default 1000000)
+ *      -f format      csv or json (default csv)
+ *      -H             omit the csv header line
+ *
+ * Notes:
+ *
+ * The queues in this directory are standalone programs, each
+ * with its own main() and the same function names, so one
+ * build of this file benchmarks one of them. Pick it with a
+ * define when compiling:
+ *
+ *   gcc -O2 -pthread queue-benchmark.c                       (array)
+ *   gcc -O2 -pthread -DBENCH_LINKED_LIST queue-benchmark.c
+ *   gcc -O2 -pthread -DBENCH_PRIORITY_QUEUE queue-benchmark.c
+ *   gcc -O2 -pthread -DBENCH_PERSISTENT queue-benchmark.c
+ *   gcc -O2 -pthread -DBENCH_ARRAY_HUGE_PAGES queue-benchmark.c
+ *
+ * BENCH_ARRAY_HUGE_PAGES is the array queue made by
+ * createQueueOnPages, on pre-faulted transparent huge pages
+ * bound to the NUMA node of the thread that creates it.
+ *
+ * The file of the chosen queue is included with its main()
+ * renamed, and malloc, calloc and free are redirected to
+ * counters. The linked list queue takes its nodes from the
+ * slab allocator, so its counts are the slabs and magazines
+ * the allocator asks for, not one per item. The queues are
+ * not thread safe, so the adapter for each one wraps every
+ * call in a mutex. An adapter is four functions:
+ * benchCreate, benchEnqueue, benchDequeue and benchDestroy.
+ * A concurrent queue only needs an adapter that calls it
+ * without the mutex.
+ *
+ * Every queue enforces the -q capacity, including the linked
+ * list one, so the runs compare like with like. A producer
+ * that finds the queue full, or a consumer that finds it
+ * empty, yields and tries again.
+ *
+ * Each item is its own id. The producer stores the time in
+ * enqueue_times[id] right before it enqueues the id, and the
+ * consumer that dequeues it stores the difference in
+ * latencies[id]. The percentiles come from sorting latencies
+ * after the run.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+// Included before malloc is redirected, so the
+// counters of -DINSTRUMENT are not counted.
+#include "../instrumentation/instrumentation.h"
+
+/*
+ *
+ * Allocation Counters
+ *
+ */
+
+static atomic_long allocation_count;
+static atomic_long free_count;
+
+// Every queue is built with all three redirected, but
+// each calls only some of them.
+__attribute__((unused))
+static void* countedMalloc(size_t size) {
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return malloc(size);
+}
+
+__attribute__((unused))
+static void* countedCalloc(size_t count, size_t size) {
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return calloc(count, size);
+}
+
+static void countedFree(void* pointer) {
+    if (pointer != NULL)
+        atomic_fetch_add_explicit(&free_count, 1, memory_order_relaxed);
+    free(pointer);
+}
+
+/*
+ *
+ * Queue Adapters
+ *
+ */
+
+#define malloc(size) countedMalloc(size)
+#define calloc(count, size) countedCalloc(count, size)
+#define free(pointer) countedFree(pointer)
+#define main queue_demo_main
+
+#if defined(BENCH_LINKED_LIST)
+
+#include "queue-using-linked-list.c"
+
+#define BENCH_NAME "linked-list+mutex"
+
+static queue bench_queue;
+
+static void benchCreate(int capacity) {
+    (void) capacity;
+    bench_queue.head = NULL;
+    bench_queue.tail = NULL;
+}
+
+static int benchEnqueue(int value) {
+    enqueue(&bench_queue, value);
+    return 1;
+}
+
+static int benchDequeue(int* value) {
+    if (isEmpty(&bench_queue))
+        return 0;
+    *value = dequeue(&bench_queue);
+    return 1;
+}
+
+static void benchDestroy(void) {
+    while (!isEmpty(&bench_queue))
+        dequeue(&bench_queue);
+}
+
+#elif defined(BENCH_PRIORITY_QUEUE)
+
+#include "priority-queue-using-heap.c"
+
+#define BENCH_NAME "priority-heap+mutex"
+
+static priority_queue* bench_queue;
+static int bench_sequence;
+
+static void benchCreate(int capacity) {
+    bench_queue = createPriorityQueue(capacity);
+    bench_sequence = 0;
+}
+
+static int benchEnqueue(int value) {
+    if (isFull(bench_queue))
+        return 0;
+    // Arrival order as priority makes it FIFO.
+    enqueue(bench_queue, value, bench_sequence++);
+    return 1;
+}
+
+static int benchDequeue(int* value) {
+    if (isEmpty(bench_queue))
+        return 0;
+    *value = dequeue(bench_queue);
+    return 1;
+}
+
+static void benchDestroy(void) {
+    freePriorityQueue(bench_queue);
+}
+
+#elif defined(BENCH_PERSISTENT)
+
+#undef _POSIX_C_SOURCE
+#include "persistent-queue-using-mmap.c"
+
+#define BENCH_NAME "persistent-mmap+mutex"
+#define BENCH_PATH "queue-benchmark.dat"
+
+static queue* bench_queue;
+
+static void benchCreate(int capacity) {
+    unlink(BENCH_PATH);
+    bench_queue = openQueue(BENCH_PATH, capacity, SYNC_EVERY_N_OPS, 1024);
+    if (bench_queue == NULL)
+        exit(1);
+}
+
+static int benchEnqueue(int value) {
+    if (isFull(bench_queue))
+        return 0;
+    // Fails only if the sync to free the slot failed,
+    // and then nothing was added. Values are ids, never -1.
+    return enqueue(bench_queue, value) != ERROR_RETURN_VALUE;
+}
+
+static int benchDequeue(int* value) {
+    if (isEmpty(bench_queue))
+        return 0;
+    *value = dequeue(bench_queue);
+    return 1;
+}
+
+static void benchDestroy(void) {
+    if (syncFailed(bench_queue))
+        printf("Error: a sync failed during the run.\n");
+    closeQueue(bench_queue);
+    unlink(BENCH_PATH);
+}
+
+#else
+
+#include "queue-using-array.c"
+
+static queue* bench_queue;
+
+#if defined(BENCH_ARRAY_HUGE_PAGES)
+
+#define BENCH_NAME "array-huge-pages+mutex"
+
+static void benchCreate(int capacity) {
+    page_options options = {PAGES_TRANSPARENT_HUGE, PAGE_NODE_LOCAL, 1};
+    bench_queue = createQueueOnPages(capacity, &options);
+}
+
+#else
+
+#define BENCH_NAME "array+mutex"
+
+static void benchCreate(int capacity) {
+    bench_queue = createQueue(capacity);
+}
+
+#endif
+
+static int benchEnqueue(int value) {
+    if (isFull(bench_queue))
+        return 0;
+    enqueue(bench_queue, value);
+    return 1;
+}
+
+static int benchDequeue(int* value) {
+    if (isEmpty(bench_queue))
+        return 0;
+    *value = dequeue(bench_queue);
+    return 1;
+}
+
+static void benchDestroy(void) {
+    freeQueue(bench_queue);
+}
+
+#endif
+
+#undef main
+#undef free
+#undef calloc
+#undef malloc
+
+/*
+ *
+ * Benchmark
+ *
+ */
+
+typedef struct options {
+    int producers;
+    int consumers;
+    int burst;
+    int capacity;
+    long items;
+    int json;
+    int header;
+} options;
+
+typedef struct producer_args {
+    long first_id; // First item id this producer sends.
+    long count; // Number of items this producer sends.
+    int burst;
+} producer_args;
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static long bench_capacity;
+static long queue_size; // Guarded by queue_lock.
+static atomic_long items_consumed;
+static long items_total;
+static uint64_t* enqueue_times;
+static uint64_t* latencies;
+
+// Benchmark
+void* runProducer(void*);
+void* runConsumer(void*);
+int tryEnqueue(int);
+int tryDequeue(int*);
+
+// Helper Function(s)
+options parseOptions(int, char*[]);
+uint64_t nowNanoseconds(void);
+int compareLatencies(const void*, const void*);
+uint64_t percentile(const uint64_t*, long, double);
+long currentRssKilobytes(void);
+long peakRssKilobytes(void);
+
+int main(int argc, char* argv[]) {
+    options opts = parseOptions(argc, argv);
+
+    items_total = opts.items;
+    bench_capacity = opts.capacity;
+    enqueue_times = calloc(opts.items, sizeof(uint64_t));
+    latencies = calloc(opts.items, sizeof(uint64_t));
+
+    pthread_t* producers = calloc(opts.producers, sizeof(pthread_t));
+    pthread_t* consumers = calloc(opts.consumers, sizeof(pthread_t));
+    producer_args* args = calloc(opts.producers, sizeof(producer_args));
+
+    benchCreate(opts.capacity);
+
+    // Only count what the queue allocates
+    // while items flow through it.
+    atomic_store(&allocation_count, 0);
+    atomic_store(&free_count, 0);
+
+    uint64_t start = nowNanoseconds();
+
+    for (int i = 0; i < opts.consumers; i++)
+        pthread_create(&consumers[i], NULL, runConsumer, NULL);
+
+    // Split the item ids evenly, the first
+    // producers take one extra if needed.
+    long first_id = 0;
+    for (int i = 0; i < opts.producers; i++) {
+        args[i].first_id = first_id;
+        args[i].count = opts.items / opts.producers
+                        + (i < opts.items % opts.producers ? 1 : 0);
+        args[i].burst = opts.burst;
+        first_id += args[i].count;
+        pthread_create(&producers[i], NULL, runProducer, &args[i]);
+    }
+
+    for (int i = 0; i < opts.producers; i++)
+        pthread_join(producers[i], NULL);
+    for (int i = 0; i < opts.consumers; i++)
+        pthread_join(consumers[i], NULL);
+
+    double seconds = (nowNanoseconds() - start) / 1e9;
+    long allocations = atomic_load(&allocation_count);
+    long frees = atomic_load(&free_count);
+    long rss = currentRssKilobytes();
+    long peak_rss = peakRssKilobytes();
+
+    benchDestroy();
+
+    qsort(latencies, opts.items, sizeof(uint64_t), compareLatencies);
+
+    double items_per_second = opts.items / seconds;
+    uint64_t p50 = percentile(latencies, opts.items, 0.50);
+    uint64_t p90 = percentile(latencies, opts.items, 0.90);
+    uint64_t p99 = percentile(latencies, opts.items, 0.99);
+    uint64_t p999 = percentile(latencies, opts.items, 0.999);
+    uint64_t max = opts.items > 0 ? latencies[opts.items - 1] : 0;
+
+    if (opts.json) {
+        printf("{\"queue\":\"%s\",\"producers\":%d,\"consumers\":%d,"
+               "\"burst\":%d,\"capacity\":%d,\"items\":%ld,"
+               "\"seconds\":%.6f,\"items_per_second\":%.0f,"
+               "\"latency_ns\":{\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,"
+               "\"p999\":%llu,\"max\":%llu},"
+               "\"allocations\":%ld,\"frees\":%ld,"
+               "\"rss_kb\":%ld,\"peak_rss_kb\":%ld}\n",
+               BENCH_NAME, opts.producers, opts.consumers,
+               opts.burst, opts.capacity, opts.items,
+               seconds, items_per_second,
+               (unsigned long long) p50, (unsigned long long) p90,
+               (unsigned long long) p99, (unsigned long long) p999,
+               (unsigned long long) max,
+               allocations, frees, rss, peak_rss);
+    } else {
+        if (opts.header)
+            printf("queue,producers,consumers,burst,capacity,items,seconds,"
+                   "items_per_second,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,"
+                   "allocations,frees,rss_kb,peak_rss_kb\n");
+        printf("%s,%d,%d,%d,%d,%ld,%.6f,%.0f,%llu,%llu,%llu,%llu,%llu,"
+               "%ld,%ld,%ld,%ld\n",
+               BENCH_NAME, opts.producers, opts.consumers,
+               opts.burst, opts.capacity, opts.items,
+               seconds, items_per_second,
+               (unsigned long long) p50, (unsigned long long) p90,
+               (unsigned long long) p99, (unsigned long long) p999,
+               (unsigned long long) max,
+               allocations, frees, rss, peak_rss);
+    }
+
+    free(enqueue_times);
+    free(latencies);
+    free(producers);
+    free(consumers);
+    free(args);
+
+    return 0;
+}
+
+/// Sends the producer's range of item ids, burst items
+/// at a time, yielding between bursts and whenever the
+/// queue is full.
+/// \param arg the producer_args
+/// \return NULL
+void* runProducer(void* arg) {
+    producer_args* args = arg;
+    long end = args->first_id + args->count;
+    long id = args->first_id;
+
+    while (id < end) {
+        for (int i = 0; i < args->burst && id < end; i++) {
+            enqueue_times[id] = nowNanoseconds();
+            while (!tryEnqueue((int) id)) {
+                sched_yield();
+                enqueue_times[id] = nowNanoseconds();
+            }
+            id++;
+        }
+        sched_yield();
+    }
+
+    return NULL;
+}
+
+/// Dequeues items until every item has been consumed,
+/// recording the latency of each one.
+/// \param arg unused
+/// \return NULL
+void* runConsumer(void* arg) {
+    (void) arg;
+    int id;
+
+    while (atomic_load_explicit(&items_consumed, memory_order_relaxed) < items_total) {
+        if (!tryDequeue(&id)) {
+            sched_yield();
+            continue;
+        }
+
+        latencies[id] = nowNanoseconds() - enqueue_times[id];
+        atomic_fetch_add_explicit(&items_consumed, 1, memory_order_relaxed);
+    }
+
+    return NULL;
+}
+
+/// Enqueues a value if the queue is below capacity.
+/// \param value
+/// \return 1 if enqueued, otherwise 0
+int tryEnqueue(int value) {
+    int enqueued = 0;
+
+    pthread_mutex_lock(&queue_lock);
+    if (queue_size < bench_capacity && benchEnqueue(value)) {
+        queue_size++;
+        enqueued = 1;
+    }
+    pthread_mutex_unlock(&queue_lock);
+
+    return enqueued;
+}
+
+/// Dequeues a value if the queue is not empty.
+/// \param value receives the value
+/// \return 1 if dequeued, otherwise 0
+int tryDequeue(int* value) {
+    int dequeued = 0;
+
+    pthread_mutex_lock(&queue_lock);
+    if (queue_size > 0 && benchDequeue(value)) {
+        queue_size--;
+        dequeued = 1;
+    }
+    pthread_mutex_unlock(&queue_lock);
+
+    return dequeued;
+}
+
+/*
+ * Helper Function(s)
+ *
+ */
+
+/// Reads the command line options.
+/// \param argc
+/// \param argv
+/// \return the options
+options parseOptions(int argc, char* argv[]) {
+    options opts = {1, 1, 1, 1024, 1000000, 0, 1};
+    int option;
+
+    while ((option = getopt(argc, argv, "p:c:b:q:n:f:H")) != -1) {
+        switch (option) {
+            case 'p': opts.producers = atoi(optarg); break;
+            case 'c': opts.consumers = atoi(optarg); break;
+            case 'b': opts.burst = atoi(optarg); break;
+            case 'q': opts.capacity = atoi(optarg); break;
+            case 'n': opts.items = atol(optarg); break;
+            case 'f': opts.json = strcmp(optarg, "json") == 0; break;
+            case 'H': opts.header = 0; break;
+            default:
+                fprintf(stderr, "Usage: %s [-p producers] [-c consumers] "
+                        "[-b burst] [-q capacity] [-n items] "
+                        "[-f csv|json] [-H]\n", argv[0]);
+                exit(1);
+        }
+    }
+
+    if (opts.producers < 1 || opts.consumers < 1 || opts.burst < 1
+        || opts.capacity < 1 || opts.items < 1 || opts.items > INT32_MAX) {
+        fprintf(stderr, "Error: Invalid option value.\n");
+        exit(1);
+    }
+
+    return opts;
+}
+
+/// Returns a monotonic time in nanoseconds.
+/// \return nanoseconds
+uint64_t nowNanoseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+/// qsort comparator for latencies.
+int compareLatencies(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+/// Returns the latency at fraction of a sorted array.
+/// \param sorted
+/// \param count
+/// \param fraction between 0 and 1
+/// \return the latency
+uint64_t percentile(const uint64_t* sorted, long count, double fraction) {
+    if (count == 0)
+        return 0;
+
+    long index = (long) (fraction * (count - 1));
+    return sorted[index];
+}
+
+/// Returns the resident set size of the process.
+/// \return RSS in kilobytes, or -1 if unknown
+long currentRssKilobytes(void) {
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL)
+        return -1;
+
+    long pages_total, pages_resident;
+    int fields = fscanf(statm, "%ld %ld", &pages_total, &pages_resident);
+    fclose(statm);
+
+    if (fields != 2)
+        return -1;
+
+    return pages_resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/// Returns the peak resident set size of the process.
+/// \return peak RSS in kilobytes
+long peakRssKilobytes(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
@@ -8,6 +8,11 @@
  *   Sample Operations:
  *      enqueue, dequeue, isEmpty, isFull
  *
+ *   Instrumentation (-DINSTRUMENT):
+ *      queue_array.enqueue, queue_array.dequeue,
+ *      queue_array.full, queue_array.empty,
+ *      queue_array.occupancy (high water)
+ *
  * Notes:
  *
  * The array is circular. Therefore, tail index can be
@@ -32,11 +37,24 @@
  * queue will be empty after the dequeue, so it sets both
  * the head and tail indexes equal to -1 (empty).
  *
+ * createQueue callocs the array. For a large queue,
+ * createQueueOnPages maps it with the page allocator
+ * instead: on huge pages, bound to a NUMA node, and
+ * faulted in up front if the options say so, so the
+ * first pass through the ring takes no page faults.
+ * Create it on the consumer thread with
+ * PAGE_NODE_LOCAL to put it next to the consumer.
+ *
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "../allocator/page-allocator.h"
+#include "../instrumentation/instrumentation.h"
+
 #define ERROR_RETURN_VALUE (-1)
 
 typedef struct queue {
@@ -44,6 +62,7 @@ typedef struct queue {
     int capacity; // Maximum size of array
     int head; // Index pointing to the head of queue.
     int tail; // Index pointing to the tail of queue.
+    size_t mapped_size; // Bytes mapped for arr, 0 if from calloc.
 } queue;
 
 // Queue Implementation
@@ -54,6 +73,7 @@ int isFull(queue*);
 
 // Helper Function(s)
 queue* createQueue(int);
+queue* createQueueOnPages(int, const page_options*);
 void freeQueue(queue*);
 
 int main() {
@@ -78,6 +98,27 @@ int main() {
     freeQueue(que);
     que = NULL;
 
+    // A big queue on transparent huge pages, on
+    // this thread's NUMA node, faulted in now.
+    page_options options = {PAGES_TRANSPARENT_HUGE, PAGE_NODE_LOCAL, 1};
+    que = createQueueOnPages(1 << 22, &options);
+
+    if (que != NULL) {
+        long sum = 0;
+        for (int j = 0; j < que->capacity; j++)
+            enqueue(que, j);
+        while (!isEmpty(que))
+            sum += dequeue(que);
+
+        printf("\nHuge page queue of %d: %zu bytes mapped, sum %ld\n",
+               que->capacity, que->mapped_size, sum);
+
+        freeQueue(que);
+        que = NULL;
+    }
+
+    INSTRUMENT_DUMP(stdout);
+
     return 0;
 }
 
@@ -96,6 +137,7 @@ int main() {
 /// \return ERROR_RETURN_VALUE if full, otherwise value
 int enqueue(queue* que, int value) {
     if (isFull(que)) {
+        INSTRUMENT_COUNT(queue_array, full, 1);
         printf("Error: Queue is full.\n");
         return ERROR_RETURN_VALUE;
     }
@@ -112,6 +154,10 @@ int enqueue(queue* que, int value) {
 
     que->arr[que->tail] = value;
 
+    INSTRUMENT_COUNT(queue_array, enqueue, 1);
+    INSTRUMENT_HIGH_WATER(queue_array, occupancy,
+                          (que->tail - que->head + que->capacity) % que->capacity + 1);
+
     return value;
 }
 
@@ -122,6 +168,7 @@ int enqueue(queue* que, int value) {
 /// \return ERROR_RETURN_VALUE if empty, otherwise value
 int dequeue(queue* que) {
     if (isEmpty(que)) {
+        INSTRUMENT_COUNT(queue_array, empty, 1);
         printf("Error: Queue is empty.\n");
         return ERROR_RETURN_VALUE;
     }
@@ -130,6 +177,7 @@ int dequeue(queue* que) {
     // will be changing the head index
     // before returning from the function.
     int value = que->arr[que->head];
+    INSTRUMENT_COUNT(queue_array, dequeue, 1);
 
     // If head == tail, and they don't
     // equal -1, this is the last item
@@ -185,9 +233,41 @@ queue* createQueue(int capacity) {
     return que;
 }
 
+/// Creates a queue whose array is mapped by the page
+/// allocator, as options say.
+/// \param capacity the maximum number of items in
+/// queue, at least 1
+/// \param options
+/// \return the queue, or NULL if capacity is less
+/// than 1 or out of memory
+queue* createQueueOnPages(int capacity, const page_options* options) {
+    if (capacity < 1)
+        return NULL;
+
+    queue* que = calloc(1, sizeof(queue));
+    if (que == NULL)
+        return NULL;
+
+    que->mapped_size = (size_t) capacity * sizeof(int);
+    que->arr = pageAlloc(&que->mapped_size, options);
+    if (que->arr == NULL) {
+        free(que);
+        return NULL;
+    }
+
+    que->capacity = capacity;
+    que->head = -1;
+    que->tail = -1;
+
+    return que;
+}
+
 /// Frees all memory used by que.
 /// \param que
 void freeQueue(queue* que) {
-    free(que->arr);
+    if (que->mapped_size != 0)
+        pageFree(que->arr, que->mapped_size);
+    else
+        free(que->arr);
     free(que);
 }
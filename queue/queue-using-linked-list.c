@@ -8,11 +8,18 @@
  *    Sample Operations:
  *      enqueue, dequeue, isEmpty
  *
+ *    Instrumentation (-DINSTRUMENT):
+ *      queue_list.enqueue, queue_list.dequeue,
+ *      queue_list.empty_dequeue
+ *
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "../allocator/slab-allocator.h"
+#include "../instrumentation/instrumentation.h"
+
 #define DEFAULT_EMPTY_VALUE (-1)
 
 typedef struct node {
@@ -53,6 +60,8 @@ int main() {
         printf("Dequeue %d\n", dequeue(&nodes));
     }
 
+    INSTRUMENT_DUMP(stdout);
+
     return 0;
 }
 
@@ -67,6 +76,7 @@ int main() {
 /// \param value
 void enqueue(queue* que, int value) {
     node* new_node = createNode(value);
+    INSTRUMENT_COUNT(queue_list, enqueue, 1);
 
     if (que->tail != NULL)
         que->tail->next = new_node;
@@ -82,19 +92,23 @@ void enqueue(queue* que, int value) {
 /// \return value from queue, otherwise
 /// DEFAULT_EMPTY_VALUE if empty
 int dequeue(queue* que) {
-    if (isEmpty(que))
+    if (isEmpty(que)) {
+        INSTRUMENT_COUNT(queue_list, empty_dequeue, 1);
         return DEFAULT_EMPTY_VALUE;
+    }
+
+    INSTRUMENT_COUNT(queue_list, dequeue, 1);
 
     // Save the node and value to
     // free and return respectively
-    node* node = que->head;
-    int value = node->value;
+    node* head_node = que->head;
+    int value = head_node->value;
 
     // Move head to next node
     que->head = que->head->next;
 
-    // Free the memory allocated by calloc
-    free(node);
+    // Give the node back to the slab allocator
+    slabFree(head_node, sizeof(node));
 
     // Deleted the only item in queue
     if (que->head == NULL)
@@ -119,7 +133,7 @@ int isEmpty(queue* que) {
 /// \param value
 /// \return the node
 node* createNode(int value) {
-    node* node = calloc(1, sizeof(node));
-    node->value = value;
-    return node;
+    node* new_node = slabCalloc(sizeof(node));
+    new_node->value = value;
+    return new_node;
 }
@@ -0,0 +1,675 @@
+/*
+ * Concurrent Self-Organizing List
+ *
+ * In self-organizing-list.c every lookup
+ * that finds its name moves the node to
+ * the front. Shared between threads, every
+ * lookup is then a write, so all of them
+ * need the lock, and readers wait for each
+ * other although they only want an age.
+ *
+ * Here lookups take no lock. They walk the
+ * list with atomic loads while one writer
+ * at a time, holding the lock, adds nodes
+ * or reorders them. Moving a node can make
+ * a reader that is walking past it skip a
+ * node, so reorders bump a sequence number
+ * (odd while one is running). A lookup that
+ * misses checks the number and, if it
+ * changed, waits for the reorder to finish
+ * and searches again. A lookup that hits
+ * needs no check.
+ *
+ * The move to the front is put off. Each
+ * list picks how:
+ *
+ *   PROMOTE_LOCKED    the baseline: lock the
+ *                     list for every lookup
+ *                     and move the node at
+ *                     once, as before.
+ *   PROMOTE_BUFFERED  a hit is written to a
+ *                     buffer of the thread's
+ *                     own. When the buffer is
+ *                     full the thread tries the
+ *                     lock, and if it gets it
+ *                     moves all those nodes to
+ *                     the front in one pass. If
+ *                     another thread has the
+ *                     lock the buffer is
+ *                     dropped. Hits never write
+ *                     to shared memory.
+ *   PROMOTE_SAMPLED   a hit moves its node with
+ *                     probability p, if the lock
+ *                     is free. Popular nodes are
+ *                     hit often, so they still
+ *                     get moved soon.
+ *   PROMOTE_CLOCK     a hit sets a referenced
+ *                     bit in the node, unless it
+ *                     is already set. A background
+ *                     thread moves the referenced
+ *                     nodes to the front now and
+ *                     then and clears their bits.
+ *
+ * A pass keeps the moved nodes in the order
+ * they had, so a batch of moves costs one walk
+ * of the list instead of one walk per node.
+ *
+ * Nodes are only freed by clear(), which
+ * must not run alongside lookups. Each list
+ * has a generation, new on every clear(), and
+ * buffered hits carry the generation they were
+ * made in, so hits from before a clear() are
+ * dropped without touching their freed nodes.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../allocator/slab-allocator.h"
+
+#define NAME_SIZE 16 // Longest name is NAME_SIZE - 1.
+#define READ_BUFFER_SIZE 64 // Hits per thread before a pass.
+#define DEFAULT_PROBABILITY 0.05
+#define MAINTENANCE_INTERVAL_US 1000
+#define BENCHMARK_LOOKUPS 100000 // Per thread.
+#define MAX_THREADS 64
+
+typedef enum promotion {
+    PROMOTE_LOCKED,
+    PROMOTE_BUFFERED,
+    PROMOTE_SAMPLED,
+    PROMOTE_CLOCK
+} promotion;
+
+typedef struct node {
+    uint32_t hash; // Hash of name.
+    atomic_int referenced; // Waiting to move to the front.
+    _Atomic(struct node*) next;
+    int age;
+    char name[NAME_SIZE]; // Zero padded.
+} node;
+
+typedef struct list {
+    _Atomic(node*) head;
+    atomic_uint sequence; // Odd while a reorder is running.
+    pthread_mutex_t lock; // Held by writers only.
+    promotion promotion;
+    double probability; // For PROMOTE_SAMPLED.
+    atomic_long promotions; // Nodes moved to the front.
+    atomic_long dropped; // Buffered hits given up on.
+    atomic_long retries; // Misses searched again.
+    pthread_t maintainer; // For PROMOTE_CLOCK.
+    atomic_int stop_maintainer;
+    atomic_ulong generation; // New on every clear.
+} list;
+
+typedef struct read_buffer {
+    list* list; // List the hits are for.
+    unsigned long generation; // Of the list when the hits were made.
+    node* nodes[READ_BUFFER_SIZE];
+    int count;
+} read_buffer;
+
+// Generations come from one counter, so a list
+// allocated where a freed one was never matches
+// hits buffered for the freed one.
+static atomic_ulong next_generation = 1;
+static _Thread_local read_buffer thread_buffer;
+static _Thread_local uint32_t thread_random = 0;
+
+// List Implementation
+void add(list*, const char*, int);
+int findAge(list*, const char*, int*);
+void clear(list*);
+void printList(list*);
+
+// Helper Function(s)
+list* createList(promotion, double);
+void freeList(list*);
+node* createNode(const char*, int);
+int padName(char*, const char*);
+uint32_t hashName(const char*);
+node* search(list*, const char*, uint32_t, int*);
+void promote(list*, node*);
+void moveToFront(list*, node*);
+void promoteReferenced(list*);
+void drainBuffer(list*);
+void* maintain(void*);
+uint32_t nextRandom(void);
+
+// Benchmark
+void runBenchmarks(void);
+
+int main() {
+    list* family = createList(PROMOTE_BUFFERED, DEFAULT_PROBABILITY);
+
+    add(family, "John", 42);
+    add(family, "Martha", 38);
+    add(family, "Rosco", 12);
+    add(family, "Cal", 10);
+    add(family, "Trish", 7);
+
+    printList(family);
+
+    // The hits wait in this thread's buffer,
+    // so the order has not changed yet.
+    findAge(family, "Martha", NULL);
+    findAge(family, "John", NULL);
+    printList(family);
+
+    // Until the buffer is drained.
+    drainBuffer(family);
+    printList(family);
+
+    int scanned;
+    int age = findAge(family, "Martha", &scanned);
+    printf("Martha is %d, found after %d nodes\n\n", age, scanned);
+
+    freeList(family);
+    family = NULL;
+
+    runBenchmarks();
+
+    return 0;
+}
+
+/*
+ *
+ * List Implementation
+ *
+ */
+
+/// Adds a new item to the head of the list.
+/// \param list
+/// \param name
+/// \param age
+void add(list* list, const char* name, int age) {
+    node* new_node = createNode(name, age);
+    if (new_node == NULL)
+        return;
+
+    pthread_mutex_lock(&list->lock);
+
+    atomic_store_explicit(&new_node->next,
+                          atomic_load_explicit(&list->head, memory_order_relaxed),
+                          memory_order_relaxed);
+
+    // Publish the filled-in node.
+    atomic_store_explicit(&list->head, new_node, memory_order_release);
+
+    pthread_mutex_unlock(&list->lock);
+}
+
+/// Finds the age of the family member and records
+/// the hit for promotion by the list's policy.
+/// \param list
+/// \param name
+/// \param nodes_scanned receives the number of nodes
+/// looked at, may be NULL
+/// \return age, or -1 if not found
+int findAge(list* list, const char* name, int* nodes_scanned) {
+    char padded_name[NAME_SIZE];
+    int scanned = 0;
+
+    if (!padName(padded_name, name)) {
+        if (nodes_scanned != NULL)
+            *nodes_scanned = 0;
+        return -1;
+    }
+
+    uint32_t hash = hashName(padded_name);
+    node* found;
+
+    if (list->promotion == PROMOTE_LOCKED) {
+        pthread_mutex_lock(&list->lock);
+        found = search(list, padded_name, hash, &scanned);
+        if (found != NULL)
+            moveToFront(list, found);
+        pthread_mutex_unlock(&list->lock);
+    } else {
+        found = search(list, padded_name, hash, &scanned);
+        if (found != NULL)
+            promote(list, found);
+    }
+
+    if (nodes_scanned != NULL)
+        *nodes_scanned = scanned;
+
+    return found != NULL ? found->age : -1;
+}
+
+/// Removes all nodes. No lookups may run at the
+/// same time, and hits buffered by PROMOTE_BUFFERED
+/// before the clear are dropped, in every thread,
+/// rather than applied to the nodes after it.
+/// \param list
+void clear(list* list) {
+    pthread_mutex_lock(&list->lock);
+
+    atomic_store(&list->generation, atomic_fetch_add(&next_generation, 1));
+
+    node* current_node = atomic_load(&list->head);
+    while (current_node != NULL) {
+        node* next_node = atomic_load(&current_node->next);
+        slabFree(current_node, sizeof(node));
+        current_node = next_node;
+    }
+
+    atomic_store(&list->head, NULL);
+    pthread_mutex_unlock(&list->lock);
+}
+
+/// Prints the names of all people in the list.
+/// \param list
+void printList(list* list) {
+    for (node* current_node = atomic_load(&list->head); current_node != NULL;
+         current_node = atomic_load(&current_node->next))
+        printf("%10s", current_node->name);
+    printf("\n");
+}
+
+/*
+ * Helper Function(s)
+ *
+ */
+
+/// Creates an empty list. PROMOTE_CLOCK also
+/// starts the background thread that moves
+/// referenced nodes.
+/// \param promotion
+/// \param probability chance a hit is promoted, for
+/// PROMOTE_SAMPLED
+/// \return the list
+list* createList(promotion promotion, double probability) {
+    list* new_list = calloc(1, sizeof(list));
+    pthread_mutex_init(&new_list->lock, NULL);
+    new_list->promotion = promotion;
+    new_list->probability = probability;
+    atomic_init(&new_list->generation, atomic_fetch_add(&next_generation, 1));
+
+    if (promotion == PROMOTE_CLOCK)
+        pthread_create(&new_list->maintainer, NULL, maintain, new_list);
+
+    return new_list;
+}
+
+/// Stops the background thread, if any, and frees
+/// the list and all of its nodes.
+/// \param list
+void freeList(list* list) {
+    if (list->promotion == PROMOTE_CLOCK) {
+        atomic_store(&list->stop_maintainer, 1);
+        pthread_join(list->maintainer, NULL);
+    }
+
+    // clear() gives the list a new generation, so no
+    // thread applies its buffered hits to freed nodes.
+    // A list created at the same address later gets a
+    // generation of its own.
+    if (thread_buffer.list == list)
+        thread_buffer.count = 0;
+
+    clear(list);
+    pthread_mutex_destroy(&list->lock);
+    free(list);
+}
+
+/// Creates and returns a new node with
+/// the proper name and age.
+/// \param name
+/// \param age
+/// \return a new node, or NULL if the name is too long
+node* createNode(const char* name, int age) {
+    char padded_name[NAME_SIZE];
+    if (!padName(padded_name, name)) {
+        printf("Error: Name %s is longer than %d characters.\n",
+               name, NAME_SIZE - 1);
+        return NULL;
+    }
+
+    node* new_node = slabCalloc(sizeof(node));
+    memcpy(new_node->name, padded_name, NAME_SIZE);
+    new_node->hash = hashName(padded_name);
+    new_node->age = age;
+    return new_node;
+}
+
+/// Copies name into a NAME_SIZE buffer and fills
+/// the rest of it with zeros.
+/// \param padded receives the padded name
+/// \param name
+/// \return 1 on success, 0 if the name is too long
+int padName(char* padded, const char* name) {
+    size_t length = strlen(name);
+
+    memset(padded, 0, NAME_SIZE);
+    if (length >= NAME_SIZE)
+        return 0;
+
+    memcpy(padded, name, length);
+    return 1;
+}
+
+/// Hashes a padded name by mixing its two
+/// 64-bit halves, no loop over the characters.
+/// \param padded
+/// \return the hash
+uint32_t hashName(const char* padded) {
+    uint64_t low, high;
+    memcpy(&low, padded, 8);
+    memcpy(&high, padded + 8, 8);
+
+    uint64_t hash = low * 0x9e3779b97f4a7c15u;
+    hash ^= high + (hash >> 29);
+    hash *= 0xbf58476d1ce4e5b9u;
+    hash ^= hash >> 32;
+
+    return (uint32_t) hash;
+}
+
+/// Walks the list without a lock. A miss that
+/// overlapped a reorder may have skipped the node,
+/// so it waits for the reorder and searches again.
+/// \param list
+/// \param padded_name
+/// \param hash hash of padded_name
+/// \param scanned counts the nodes looked at
+/// \return the node, or NULL if not found
+node* search(list* list, const char* padded_name, uint32_t hash, int* scanned) {
+    for (;;) {
+        unsigned sequence = atomic_load_explicit(&list->sequence, memory_order_acquire);
+
+        node* current_node = atomic_load_explicit(&list->head, memory_order_acquire);
+        while (current_node != NULL) {
+            (*scanned)++;
+            if (current_node->hash == hash
+                && memcmp(current_node->name, padded_name, NAME_SIZE) == 0)
+                return current_node;
+            current_node = atomic_load_explicit(&current_node->next, memory_order_acquire);
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        if ((sequence & 1) == 0
+            && atomic_load_explicit(&list->sequence, memory_order_relaxed) == sequence)
+            return NULL;
+
+        // Let the reorder finish before looking again.
+        atomic_fetch_add_explicit(&list->retries, 1, memory_order_relaxed);
+        while (atomic_load_explicit(&list->sequence, memory_order_acquire) & 1)
+            sched_yield();
+    }
+}
+
+/// Records a hit for promotion, by the list's policy.
+/// \param list
+/// \param found
+void promote(list* list, node* found) {
+    unsigned long generation;
+
+    switch (list->promotion) {
+        case PROMOTE_LOCKED:
+            break;
+
+        case PROMOTE_BUFFERED:
+            generation = atomic_load_explicit(&list->generation, memory_order_relaxed);
+            if (thread_buffer.list != list || thread_buffer.generation != generation) {
+                thread_buffer.list = list;
+                thread_buffer.generation = generation;
+                thread_buffer.count = 0;
+            }
+
+            thread_buffer.nodes[thread_buffer.count++] = found;
+            if (thread_buffer.count == READ_BUFFER_SIZE)
+                drainBuffer(list);
+            break;
+
+        case PROMOTE_SAMPLED:
+            if (nextRandom() >= list->probability * 4294967296.0)
+                break;
+            if (atomic_load_explicit(&list->head, memory_order_relaxed) == found)
+                break;
+            if (pthread_mutex_trylock(&list->lock) == 0) {
+                moveToFront(list, found);
+                pthread_mutex_unlock(&list->lock);
+            }
+            break;
+
+        case PROMOTE_CLOCK:
+            // Read before writing, so hot nodes are not
+            // written to by every reader.
+            if (!atomic_load_explicit(&found->referenced, memory_order_relaxed))
+                atomic_store_explicit(&found->referenced, 1, memory_order_relaxed);
+            break;
+    }
+}
+
+/// Moves a node to the front. The lock must be held.
+/// \param list
+/// \param found
+void moveToFront(list* list, node* found) {
+    node* head = atomic_load_explicit(&list->head, memory_order_relaxed);
+    if (head == found)
+        return;
+
+    node* previous_node = head;
+    while (atomic_load_explicit(&previous_node->next, memory_order_relaxed) != found)
+        previous_node = atomic_load_explicit(&previous_node->next, memory_order_relaxed);
+
+    atomic_fetch_add_explicit(&list->sequence, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&previous_node->next,
+                          atomic_load_explicit(&found->next, memory_order_relaxed),
+                          memory_order_release);
+    atomic_store_explicit(&found->next, head, memory_order_release);
+    atomic_store_explicit(&list->head, found, memory_order_release);
+
+    atomic_fetch_add_explicit(&list->sequence, 1, memory_order_release);
+    atomic_fetch_add_explicit(&list->promotions, 1, memory_order_relaxed);
+}
+
+/// Moves every referenced node to the front in one
+/// walk, keeping their order, and clears their bits.
+/// The lock must be held.
+/// \param list
+void promoteReferenced(list* list) {
+    node* moved_head = NULL;
+    node* moved_tail = NULL;
+    node* previous_node = NULL;
+    long moved = 0;
+
+    atomic_fetch_add_explicit(&list->sequence, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    node* current_node = atomic_load_explicit(&list->head, memory_order_relaxed);
+    while (current_node != NULL) {
+        node* next_node = atomic_load_explicit(&current_node->next, memory_order_relaxed);
+
+        if (!atomic_load_explicit(&current_node->referenced, memory_order_relaxed)) {
+            previous_node = current_node;
+            current_node = next_node;
+            continue;
+        }
+
+        atomic_store_explicit(&current_node->referenced, 0, memory_order_relaxed);
+
+        // Unlink it. Readers on it still reach next_node.
+        if (previous_node == NULL)
+            atomic_store_explicit(&list->head, next_node, memory_order_release);
+        else
+            atomic_store_explicit(&previous_node->next, next_node, memory_order_release);
+
+        // Append it to the moved nodes. Its own next
+        // pointer is fixed up by the next append or
+        // by the splice below.
+        if (moved_tail == NULL)
+            moved_head = current_node;
+        else
+            atomic_store_explicit(&moved_tail->next, current_node, memory_order_release);
+        moved_tail = current_node;
+        moved++;
+
+        current_node = next_node;
+    }
+
+    if (moved_head != NULL) {
+        atomic_store_explicit(&moved_tail->next,
+                              atomic_load_explicit(&list->head, memory_order_relaxed),
+                              memory_order_release);
+        atomic_store_explicit(&list->head, moved_head, memory_order_release);
+    }
+
+    atomic_fetch_add_explicit(&list->sequence, 1, memory_order_release);
+    atomic_fetch_add_explicit(&list->promotions, moved, memory_order_relaxed);
+}
+
+/// Applies this thread's buffered hits if the lock
+/// is free, otherwise drops them.
+/// \param list
+void drainBuffer(list* list) {
+    if (thread_buffer.list != list || thread_buffer.count == 0)
+        return;
+
+    if (pthread_mutex_trylock(&list->lock) == 0) {
+        // The nodes of an older generation are freed.
+        if (thread_buffer.generation == atomic_load(&list->generation)) {
+            for (int i = 0; i < thread_buffer.count; i++)
+                atomic_store_explicit(&thread_buffer.nodes[i]->referenced, 1,
+                                      memory_order_relaxed);
+            promoteReferenced(list);
+        }
+        pthread_mutex_unlock(&list->lock);
+    } else {
+        atomic_fetch_add_explicit(&list->dropped, thread_buffer.count, memory_order_relaxed);
+    }
+
+    thread_buffer.count = 0;
+}
+
+/// Background thread of a PROMOTE_CLOCK list.
+/// \param argument the list
+/// \return NULL
+void* maintain(void* argument) {
+    list* list = argument;
+    struct timespec interval = {0, MAINTENANCE_INTERVAL_US * 1000};
+
+    while (!atomic_load(&list->stop_maintainer)) {
+        nanosleep(&interval, NULL);
+
+        pthread_mutex_lock(&list->lock);
+        promoteReferenced(list);
+        pthread_mutex_unlock(&list->lock);
+    }
+
+    return NULL;
+}
+
+/// xorshift32 with a state per thread.
+/// \return a random number
+uint32_t nextRandom(void) {
+    if (thread_random == 0)
+        thread_random = (uint32_t) (uintptr_t) &thread_random | 1;
+
+    thread_random ^= thread_random << 13;
+    thread_random ^= thread_random >> 17;
+    thread_random ^= thread_random << 5;
+
+    return thread_random;
+}
+
+/*
+ * Benchmark
+ *
+ */
+
+typedef struct benchmark_args {
+    list* list;
+    int names;
+    long scanned; // Nodes looked at by this thread.
+} benchmark_args;
+
+/// Looks up names with a skew towards a few of them.
+/// \param argument benchmark_args
+/// \return NULL
+void* runLookups(void* argument) {
+    benchmark_args* args = argument;
+    char name[NAME_SIZE];
+    int scanned;
+
+    for (int i = 0; i < BENCHMARK_LOOKUPS; i++) {
+        // The product of two uniform numbers
+        // favours small indexes.
+        uint32_t first = nextRandom() % args->names;
+        uint32_t second = nextRandom() % args->names;
+        sprintf(name, "name%u", first * second / args->names);
+
+        findAge(args->list, name, &scanned);
+        args->scanned += scanned;
+    }
+
+    drainBuffer(args->list);
+
+    return NULL;
+}
+
+/// Runs the same lookups from 1 to MAX_THREADS
+/// threads against each policy and prints lookups
+/// per second and the average number of nodes looked
+/// at, which shows how much of the move-to-front
+/// benefit each policy keeps.
+void runBenchmarks(void) {
+    const char* labels[] = {"locked", "buffered", "sampled", "clock"};
+    const int names = 200;
+    char name[NAME_SIZE];
+
+    printf("%-10s %7s %14s %12s %10s\n",
+           "Policy", "Threads", "lookups/s", "avg scanned", "dropped");
+
+    for (int policy = PROMOTE_LOCKED; policy <= PROMOTE_CLOCK; policy++) {
+        for (int threads = 1; threads <= MAX_THREADS; threads *= 4) {
+            list* people = createList(policy, DEFAULT_PROBABILITY);
+
+            // Popular names last, so the list has to learn.
+            for (int i = names - 1; i >= 0; i--) {
+                sprintf(name, "name%d", i);
+                add(people, name, i);
+            }
+
+            pthread_t ids[MAX_THREADS];
+            benchmark_args args[MAX_THREADS];
+            struct timespec start, end;
+
+            clock_gettime(CLOCK_MONOTONIC, &start);
+
+            for (int i = 0; i < threads; i++) {
+                args[i] = (benchmark_args) {people, names, 0};
+                pthread_create(&ids[i], NULL, runLookups, &args[i]);
+            }
+
+            long scanned = 0;
+            for (int i = 0; i < threads; i++) {
+                pthread_join(ids[i], NULL);
+                scanned += args[i].scanned;
+            }
+
+            clock_gettime(CLOCK_MONOTONIC, &end);
+
+            double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+            long lookups = (long) threads * BENCHMARK_LOOKUPS;
+
+            printf("%-10s %7d %14.0f %12.2f %10ld\n", labels[policy], threads,
+                   lookups / seconds, (double) scanned / lookups, atomic_load(&people->dropped));
+
+            freeList(people);
+        }
+    }
+}
@@ -0,0 +1,748 @@
+/*
+ * Self-Organizing Cache
+ *
+ * self-organizing-list.c moves a found
+ * item to the front so that popular items
+ * are found quickly. Used as a cache it has
+ * two problems: findAge is O(n), and the
+ * list grows without limit.
+ *
+ * This cache keeps the move-to-front idea
+ * but finds entries through a hash table,
+ * so lookups are O(1), and it holds at most
+ * a fixed capacity, counted in entries or
+ * in bytes. When it is over capacity, an
+ * eviction policy picks what to drop:
+ *
+ *   LRU         the recency list is the
+ *               move-to-front list. A hit
+ *               moves the entry to the head
+ *               and the tail is evicted.
+ *   CLOCK       a hit only sets a referenced
+ *               bit, so hits never write to
+ *               the list. A hand sweeps from
+ *               the tail, clearing set bits,
+ *               and evicts the first entry
+ *               whose bit was already clear.
+ *   TINY_LFU    W-TinyLFU. New entries go to
+ *               a small LRU window (1%). An
+ *               entry leaving the window only
+ *               gets into the main cache if it
+ *               has been asked for more often
+ *               than the entry it would push
+ *               out. How often is estimated
+ *               by a count-min sketch that
+ *               halves all counts now and then
+ *               so old popularity fades. The
+ *               main cache is a segmented LRU:
+ *               entries start in probation and
+ *               move to protected (80%) on a
+ *               second hit. A scan of one-off
+ *               keys cannot flush the popular
+ *               entries out.
+ *
+ * The list links are stored in the entries
+ * themselves (an intrusive list), as is the
+ * hash chain link, so an entry is a single
+ * allocation, name included.
+ *
+ * In bytes mode an entry weighs its struct
+ * plus its name. In entries mode it weighs 1.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../allocator/slab-allocator.h"
+
+#define SKETCH_ROWS 4
+#define SKETCH_MAX_COUNT 15
+#define WINDOW_PERCENT 1
+#define PROTECTED_PERCENT 80
+
+typedef enum eviction_policy {
+    LRU,
+    CLOCK,
+    TINY_LFU
+} eviction_policy;
+
+typedef enum capacity_unit {
+    CAPACITY_ENTRIES,
+    CAPACITY_BYTES
+} capacity_unit;
+
+typedef enum segment_id {
+    WINDOW, // LRU and CLOCK use only this one.
+    PROBATION,
+    PROTECTED,
+    SEGMENT_COUNT
+} segment_id;
+
+typedef struct entry {
+    struct entry* hash_next; // Next entry in the bucket.
+    struct entry* previous; // Towards the head (more recent).
+    struct entry* next; // Towards the tail (less recent).
+    uint64_t hash;
+    size_t weight;
+    int age;
+    unsigned char segment;
+    unsigned char referenced; // For CLOCK.
+    char name[];
+} entry;
+
+typedef struct segment {
+    entry* head;
+    entry* tail;
+    size_t weight;
+    size_t max_weight;
+} segment;
+
+typedef struct frequency_sketch {
+    unsigned char* counters; // SKETCH_ROWS rows of width.
+    size_t width_mask;
+    long additions;
+    long sample_size; // Additions between halvings.
+} frequency_sketch;
+
+typedef struct cache {
+    eviction_policy policy;
+    capacity_unit unit;
+    size_t capacity;
+    size_t weight; // Weight of all entries.
+    size_t count; // Number of entries.
+    entry** buckets;
+    size_t bucket_mask;
+    segment segments[SEGMENT_COUNT];
+    entry* hand; // For CLOCK.
+    frequency_sketch sketch; // For TINY_LFU.
+    long hits;
+    long misses;
+    long evictions;
+} cache;
+
+// Cache Implementation
+int add(cache*, const char*, int);
+int findAge(cache*, const char*);
+void clear(cache*);
+void printStats(cache*, const char*);
+
+// Helper Function(s)
+cache* createCache(size_t, capacity_unit, eviction_policy);
+void freeCache(cache*);
+uint64_t hashName(const char*);
+size_t entrySize(entry*);
+entry* lookup(cache*, const char*, uint64_t);
+void insertHash(cache*, entry*);
+void removeHash(cache*, entry*);
+void growBuckets(cache*);
+void pushFront(cache*, segment_id, entry*);
+void unlinkEntry(cache*, entry*);
+void onHit(cache*, entry*);
+void evict(cache*, entry*);
+void evictOverCapacity(cache*);
+void evictClock(cache*);
+void evictTinyLfu(cache*);
+void recordAccess(frequency_sketch*, uint64_t);
+int estimateFrequency(frequency_sketch*, uint64_t);
+size_t sketchIndex(frequency_sketch*, uint64_t, int);
+
+// Benchmark
+void compareWorkload(eviction_policy, const char*);
+
+int main() {
+    const char* names[] = {"John", "Martha", "Rosco", "Cal", "Trish"};
+    const char* labels[] = {"LRU", "CLOCK", "W-TinyLFU"};
+
+    // Room for three of the five family members.
+    for (int policy = LRU; policy <= TINY_LFU; policy++) {
+        cache* family = createCache(3, CAPACITY_ENTRIES, policy);
+
+        add(family, "John", 42);
+        add(family, "Martha", 38);
+        findAge(family, "John");
+        findAge(family, "John");
+        add(family, "Rosco", 12);
+        add(family, "Cal", 10);
+        add(family, "Trish", 7);
+
+        printf("%-10s", labels[policy]);
+        for (int i = 0; i < 5; i++) {
+            if (lookup(family, names[i], hashName(names[i])) != NULL)
+                printf("%8s", names[i]);
+        }
+        printf("\n");
+
+        freeCache(family);
+    }
+
+    // Capacity in bytes: long names take more room.
+    cache* relatives = createCache(3 * (sizeof(entry) + 8), CAPACITY_BYTES, LRU);
+    add(relatives, "Jo", 70);
+    add(relatives, "Al", 68);
+    add(relatives, "Bartholomew Jr.", 45);
+    add(relatives, "Ann", 40);
+    findAge(relatives, "Jo");
+    findAge(relatives, "Al");
+    printf("\n%zu entries in %zu of %zu bytes\n",
+           relatives->count, relatives->weight, relatives->capacity);
+    printStats(relatives, "Bytes");
+    freeCache(relatives);
+
+    printf("\n%-10s %9s %10s %10s %10s\n",
+           "Policy", "hit rate", "evictions", "ns/op", "kB used");
+    compareWorkload(LRU, "LRU");
+    compareWorkload(CLOCK, "CLOCK");
+    compareWorkload(TINY_LFU, "W-TinyLFU");
+
+    return 0;
+}
+
+/*
+ *
+ * Cache Implementation
+ *
+ */
+
+/// Adds a family member, or updates their age if
+/// already cached. Evicts entries as needed to stay
+/// within the capacity.
+/// \param cache
+/// \param name
+/// \param age
+/// \return 1 if cached, 0 if the entry alone is
+/// larger than the capacity or out of memory
+int add(cache* cache, const char* name, int age) {
+    uint64_t hash = hashName(name);
+    entry* found = lookup(cache, name, hash);
+
+    if (cache->policy == TINY_LFU)
+        recordAccess(&cache->sketch, hash);
+
+    if (found != NULL) {
+        found->age = age;
+        onHit(cache, found);
+        return 1;
+    }
+
+    size_t length = strlen(name);
+    size_t weight = cache->unit == CAPACITY_BYTES ? sizeof(entry) + length + 1 : 1;
+
+    if (weight > cache->capacity)
+        return 0;
+
+    entry* new_entry = slabAlloc(sizeof(entry) + length + 1);
+    if (new_entry == NULL)
+        return 0;
+
+    memcpy(new_entry->name, name, length + 1);
+    new_entry->hash = hash;
+    new_entry->weight = weight;
+    new_entry->age = age;
+    new_entry->referenced = 0;
+
+    insertHash(cache, new_entry);
+    pushFront(cache, WINDOW, new_entry);
+    cache->count++;
+    cache->weight += weight;
+
+    evictOverCapacity(cache);
+
+    return 1;
+}
+
+/// Finds the age of the family member, counting
+/// a hit or a miss.
+/// \param cache
+/// \param name
+/// \return age, or -1 if not cached
+int findAge(cache* cache, const char* name) {
+    uint64_t hash = hashName(name);
+    entry* found = lookup(cache, name, hash);
+
+    if (cache->policy == TINY_LFU)
+        recordAccess(&cache->sketch, hash);
+
+    if (found == NULL) {
+        cache->misses++;
+        return -1;
+    }
+
+    cache->hits++;
+    onHit(cache, found);
+
+    return found->age;
+}
+
+/// Removes all entries. The counters are kept.
+/// \param cache
+void clear(cache* cache) {
+    for (int i = 0; i < SEGMENT_COUNT; i++) {
+        entry* current_entry = cache->segments[i].head;
+
+        while (current_entry != NULL) {
+            entry* next_entry = current_entry->next;
+            slabFree(current_entry, entrySize(current_entry));
+            current_entry = next_entry;
+        }
+
+        cache->segments[i].head = NULL;
+        cache->segments[i].tail = NULL;
+        cache->segments[i].weight = 0;
+    }
+
+    memset(cache->buckets, 0, (cache->bucket_mask + 1) * sizeof(entry*));
+    cache->hand = NULL;
+    cache->count = 0;
+    cache->weight = 0;
+}
+
+/// Prints the hit, miss and eviction counters.
+/// \param cache
+/// \param label
+void printStats(cache* cache, const char* label) {
+    long lookups = cache->hits + cache->misses;
+    printf("%s: %ld hits, %ld misses, %ld evictions, hit rate %.1f%%\n",
+           label, cache->hits, cache->misses, cache->evictions,
+           lookups ? 100.0 * cache->hits / lookups : 0);
+}
+
+/*
+ * Helper Function(s)
+ *
+ */
+
+/// Creates an empty cache.
+/// \param capacity maximum total weight
+/// \param unit whether capacity counts entries or bytes
+/// \param policy
+/// \return the cache
+cache* createCache(size_t capacity, capacity_unit unit, eviction_policy policy) {
+    cache* new_cache = calloc(1, sizeof(cache));
+    new_cache->policy = policy;
+    new_cache->unit = unit;
+    new_cache->capacity = capacity;
+
+    new_cache->bucket_mask = 15;
+    new_cache->buckets = calloc(new_cache->bucket_mask + 1, sizeof(entry*));
+
+    if (policy == TINY_LFU) {
+        size_t window = capacity * WINDOW_PERCENT / 100;
+        size_t main = capacity - (window > 0 ? window : 1);
+
+        new_cache->segments[WINDOW].max_weight = window > 0 ? window : 1;
+        new_cache->segments[PROTECTED].max_weight = main * PROTECTED_PERCENT / 100;
+
+        // One counter per expected entry and row. In bytes
+        // mode, guess entries of about 64 bytes.
+        size_t entries = unit == CAPACITY_BYTES ? capacity / 64 : capacity;
+        size_t width = 16;
+        while (width < entries)
+            width *= 2;
+
+        new_cache->sketch.counters = calloc(SKETCH_ROWS * width, 1);
+        new_cache->sketch.width_mask = width - 1;
+        new_cache->sketch.sample_size = 10 * (long) width;
+    }
+
+    return new_cache;
+}
+
+/// Frees the cache and all of its entries.
+/// \param cache
+void freeCache(cache* cache) {
+    clear(cache);
+    free(cache->buckets);
+    free(cache->sketch.counters);
+    free(cache);
+}
+
+/// FNV-1a hash of a name.
+/// \param name
+/// \return the hash
+uint64_t hashName(const char* name) {
+    uint64_t hash = 14695981039346656037u;
+
+    for (const char* c = name; *c != '\0'; c++) {
+        hash ^= (unsigned char) *c;
+        hash *= 1099511628211u;
+    }
+
+    return hash;
+}
+
+/// Returns the number of bytes allocated for
+/// an entry, name included.
+/// \param entry
+/// \return the size
+size_t entrySize(entry* entry) {
+    return sizeof(*entry) + strlen(entry->name) + 1;
+}
+
+/// Finds the entry for a name in the hash table.
+/// \param cache
+/// \param name
+/// \param hash hash of name
+/// \return the entry, or NULL if not cached
+entry* lookup(cache* cache, const char* name, uint64_t hash) {
+    entry* current_entry = cache->buckets[hash & cache->bucket_mask];
+
+    while (current_entry != NULL) {
+        if (current_entry->hash == hash && strcmp(current_entry->name, name) == 0)
+            return current_entry;
+        current_entry = current_entry->hash_next;
+    }
+
+    return NULL;
+}
+
+/// Adds an entry to the hash table, doubling the
+/// buckets once there are more entries than buckets.
+/// \param cache
+/// \param new_entry
+void insertHash(cache* cache, entry* new_entry) {
+    if (cache->count >= cache->bucket_mask + 1)
+        growBuckets(cache);
+
+    entry** bucket = &cache->buckets[new_entry->hash & cache->bucket_mask];
+    new_entry->hash_next = *bucket;
+    *bucket = new_entry;
+}
+
+/// Removes an entry from the hash table.
+/// \param cache
+/// \param old_entry
+void removeHash(cache* cache, entry* old_entry) {
+    entry** link = &cache->buckets[old_entry->hash & cache->bucket_mask];
+
+    while (*link != old_entry)
+        link = &(*link)->hash_next;
+
+    *link = old_entry->hash_next;
+}
+
+/// Doubles the number of buckets.
+/// \param cache
+void growBuckets(cache* cache) {
+    size_t new_mask = cache->bucket_mask * 2 + 1;
+    entry** new_buckets = calloc(new_mask + 1, sizeof(entry*));
+
+    for (size_t i = 0; i <= cache->bucket_mask; i++) {
+        entry* current_entry = cache->buckets[i];
+
+        while (current_entry != NULL) {
+            entry* next_entry = current_entry->hash_next;
+            entry** bucket = &new_buckets[current_entry->hash & new_mask];
+            current_entry->hash_next = *bucket;
+            *bucket = current_entry;
+            current_entry = next_entry;
+        }
+    }
+
+    free(cache->buckets);
+    cache->buckets = new_buckets;
+    cache->bucket_mask = new_mask;
+}
+
+/// Puts an entry at the head of a segment.
+/// \param cache
+/// \param id
+/// \param new_entry an entry in no segment
+void pushFront(cache* cache, segment_id id, entry* new_entry) {
+    segment* list = &cache->segments[id];
+
+    new_entry->segment = id;
+    new_entry->previous = NULL;
+    new_entry->next = list->head;
+
+    if (list->head != NULL)
+        list->head->previous = new_entry;
+    else
+        list->tail = new_entry;
+
+    list->head = new_entry;
+    list->weight += new_entry->weight;
+}
+
+/// Takes an entry out of its segment.
+/// \param cache
+/// \param old_entry
+void unlinkEntry(cache* cache, entry* old_entry) {
+    segment* list = &cache->segments[old_entry->segment];
+
+    // Keep the clock hand off removed entries.
+    if (cache->hand == old_entry)
+        cache->hand = old_entry->previous;
+
+    if (old_entry->previous != NULL)
+        old_entry->previous->next = old_entry->next;
+    else
+        list->head = old_entry->next;
+
+    if (old_entry->next != NULL)
+        old_entry->next->previous = old_entry->previous;
+    else
+        list->tail = old_entry->previous;
+
+    list->weight -= old_entry->weight;
+}
+
+/// Updates the entry's position after it was
+/// asked for, according to the policy.
+/// \param cache
+/// \param found
+void onHit(cache* cache, entry* found) {
+    switch (cache->policy) {
+        case LRU:
+            // Move to front.
+            unlinkEntry(cache, found);
+            pushFront(cache, WINDOW, found);
+            break;
+
+        case CLOCK:
+            found->referenced = 1;
+            break;
+
+        case TINY_LFU:
+            unlinkEntry(cache, found);
+
+            if (found->segment == WINDOW) {
+                pushFront(cache, WINDOW, found);
+                break;
+            }
+
+            // A second hit promotes from probation. Protected
+            // overflow goes back to probation, not out.
+            pushFront(cache, PROTECTED, found);
+
+            segment* protected = &cache->segments[PROTECTED];
+            while (protected->weight > protected->max_weight && protected->tail != found) {
+                entry* demoted = protected->tail;
+                unlinkEntry(cache, demoted);
+                pushFront(cache, PROBATION, demoted);
+            }
+            break;
+    }
+}
+
+/// Removes and frees an entry.
+/// \param cache
+/// \param old_entry
+void evict(cache* cache, entry* old_entry) {
+    unlinkEntry(cache, old_entry);
+    removeHash(cache, old_entry);
+
+    cache->count--;
+    cache->weight -= old_entry->weight;
+    cache->evictions++;
+
+    slabFree(old_entry, entrySize(old_entry));
+}
+
+/// Evicts entries until the cache is within
+/// its capacity.
+/// \param cache
+void evictOverCapacity(cache* cache) {
+    switch (cache->policy) {
+        case LRU:
+            while (cache->weight > cache->capacity)
+                evict(cache, cache->segments[WINDOW].tail);
+            break;
+
+        case CLOCK:
+            evictClock(cache);
+            break;
+
+        case TINY_LFU:
+            evictTinyLfu(cache);
+            break;
+    }
+}
+
+/// Sweeps the clock hand from the tail towards the
+/// head, wrapping around, giving referenced entries
+/// a second chance.
+/// \param cache
+void evictClock(cache* cache) {
+    segment* list = &cache->segments[WINDOW];
+
+    while (cache->weight > cache->capacity) {
+        if (cache->hand == NULL)
+            cache->hand = list->tail;
+
+        entry* current_entry = cache->hand;
+
+        if (current_entry->referenced) {
+            current_entry->referenced = 0;
+            cache->hand = current_entry->previous;
+        } else {
+            evict(cache, current_entry);
+        }
+    }
+}
+
+/// Moves entries that overflow the window into
+/// probation, then, while the cache is over capacity,
+/// lets each newcomer compete with the probation
+/// tail on estimated frequency. The loser is evicted.
+/// \param cache
+void evictTinyLfu(cache* cache) {
+    segment* window = &cache->segments[WINDOW];
+    segment* probation = &cache->segments[PROBATION];
+    segment* protected = &cache->segments[PROTECTED];
+
+    while (window->weight > window->max_weight && window->tail != window->head) {
+        entry* candidate = window->tail;
+        unlinkEntry(cache, candidate);
+        pushFront(cache, PROBATION, candidate);
+
+        if (cache->weight <= cache->capacity)
+            continue;
+
+        // The victim is the least recent entry of the
+        // main cache other than the candidate itself.
+        entry* victim = probation->tail != candidate ? probation->tail : protected->tail;
+
+        if (victim == NULL) {
+            evict(cache, candidate);
+        } else if (estimateFrequency(&cache->sketch, candidate->hash)
+                   > estimateFrequency(&cache->sketch, victim->hash)) {
+            evict(cache, victim);
+        } else {
+            evict(cache, candidate);
+        }
+    }
+
+    // Still over, e.g. a heavy entry in bytes mode.
+    while (cache->weight > cache->capacity) {
+        entry* victim = probation->tail;
+        if (victim == NULL)
+            victim = protected->tail;
+        if (victim == NULL)
+            victim = window->tail;
+        evict(cache, victim);
+    }
+}
+
+/// Counts an access in the sketch. After sample_size
+/// accesses every counter is halved, so the sketch
+/// tracks recent popularity.
+/// \param sketch
+/// \param hash
+void recordAccess(frequency_sketch* sketch, uint64_t hash) {
+    for (int row = 0; row < SKETCH_ROWS; row++) {
+        unsigned char* counter = &sketch->counters[sketchIndex(sketch, hash, row)];
+        if (*counter < SKETCH_MAX_COUNT)
+            (*counter)++;
+    }
+
+    sketch->additions++;
+
+    if (sketch->additions >= sketch->sample_size) {
+        size_t total = SKETCH_ROWS * (sketch->width_mask + 1);
+        for (size_t i = 0; i < total; i++)
+            sketch->counters[i] /= 2;
+        sketch->additions /= 2;
+    }
+}
+
+/// Estimates how often a hash was accessed as the
+/// smallest of its counters, which collisions can only
+/// have pushed up.
+/// \param sketch
+/// \param hash
+/// \return the estimate
+int estimateFrequency(frequency_sketch* sketch, uint64_t hash) {
+    int estimate = SKETCH_MAX_COUNT;
+
+    for (int row = 0; row < SKETCH_ROWS; row++) {
+        int count = sketch->counters[sketchIndex(sketch, hash, row)];
+        if (count < estimate)
+            estimate = count;
+    }
+
+    return estimate;
+}
+
+/// Returns the counter of a hash in a row. Each
+/// row mixes the hash with its own odd constant.
+/// \param sketch
+/// \param hash
+/// \param row
+/// \return index into counters
+size_t sketchIndex(frequency_sketch* sketch, uint64_t hash, int row) {
+    static const uint64_t seeds[SKETCH_ROWS] = {
+        0x9e3779b97f4a7c15u, 0xbf58476d1ce4e5b9u,
+        0x94d049bb133111ebu, 0xd6e8feb86659fd93u
+    };
+
+    uint64_t mixed = (hash ^ (hash >> 31)) * seeds[row];
+    size_t column = (mixed >> 32) & sketch->width_mask;
+
+    return row * (sketch->width_mask + 1) + column;
+}
+
+/*
+ * Benchmark
+ *
+ */
+
+/// Runs the same lookups against a 1000 entry cache
+/// using the given policy. 20000 names are asked for
+/// with a skew towards a few, interrupted by scans
+/// of names that are asked for once. A miss adds
+/// the name, as a cache in front of a slower store
+/// would.
+/// \param policy
+/// \param label
+void compareWorkload(eviction_policy policy, const char* label) {
+    const int names = 20000;
+    const int lookups = 1000000;
+    char name[16];
+
+    cache* people = createCache(1000, CAPACITY_ENTRIES, policy);
+    srand(7);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int scan_next = names;
+
+    for (int i = 0; i < lookups; i++) {
+        // Every 10000 lookups, scan 2000 new names.
+        if (i % 10000 < 2000) {
+            sprintf(name, "n%d", scan_next++);
+        } else {
+            // The product of three uniform numbers
+            // favours small indexes.
+            long index = (long) (rand() % names) * (rand() % names) / names
+                         * (rand() % names) / names;
+            sprintf(name, "n%ld", index);
+        }
+
+        if (findAge(people, name) == -1)
+            add(people, name, i);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double nanoseconds = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+
+    size_t bytes = 0;
+    for (int i = 0; i < SEGMENT_COUNT; i++) {
+        for (entry* current_entry = people->segments[i].head; current_entry != NULL;
+             current_entry = current_entry->next)
+            bytes += sizeof(entry) + strlen(current_entry->name) + 1;
+    }
+    bytes += (people->bucket_mask + 1) * sizeof(entry*);
+
+    printf("%-10s %8.1f%% %10ld %10.0f %10.1f\n", label,
+           100.0 * people->hits / (people->hits + people->misses),
+           people->evictions, nanoseconds / lookups, bytes / 1024.0);
+
+    freeCache(people);
+}
@@ -10,37 +10,208 @@
  * times by moving the frequently accessed
  * items to the front of the list.
  *
- * This example uses a Move-To-Front Strategy
- * to move a recently searched for item
- * to the head of the list.
+ * Each list picks how it reorganizes
+ * itself after a successful search:
+ *
+ *   MOVE_TO_FRONT  moves the item to the
+ *                  head of the list.
+ *   TRANSPOSE      swaps the item with the
+ *                  one in front of it. Slower
+ *                  to adapt, but a single odd
+ *                  lookup barely moves things.
+ *   COUNT          counts lookups per item and
+ *                  keeps items with higher counts
+ *                  in front.
+ *   MOVE_AHEAD_K   moves the item k places
+ *                  towards the head.
+ *   ADAPTIVE       tries each of the above for a
+ *                  window of lookups, keeps the
+ *                  one with the lowest average
+ *                  search depth for a while, and
+ *                  then tries them all again, so
+ *                  it follows shifting patterns.
  *
  * It also adds any new items to the head of
  * the list as they may be accessed shortly
  * after being added to the list.
  *
+ * findAge reports how many nodes it looked
+ * at, and the list keeps totals, so the
+ * policies can be compared on real lookups.
+ *
+ * Names are stored zero padded in a 16-byte
+ * field, so two names are equal exactly when
+ * their 16 bytes are, which is one SSE2
+ * compare instead of a strcmp loop. Each
+ * node also keeps a 32-bit hash of its name.
+ * findAge pads and hashes the name it looks
+ * for once, then checks the hash of each node
+ * before comparing names. A node with another
+ * name almost never has the same hash, so a
+ * miss costs one integer compare per node.
+ * The hash and next pointer sit at the start
+ * of the node, so skipping a node only reads
+ * its first few bytes.
+ *
+ * Names longer than 15 characters keep their
+ * first 15 in the field, with a marker in the
+ * last byte that no short name has, and the
+ * whole name follows the node, prefixed by
+ * its length. Only when the hash and the first
+ * 16 bytes match are the long names compared.
+ *
+ * Nodes and long names come from an arena of
+ * the list's own: big chunks of memory handed
+ * out front to back, with no per-node malloc
+ * header. The list never frees single nodes,
+ * so clear() just rewinds the arena to its
+ * first chunk, in O(1), and later adds reuse
+ * the chunks.
+ *
+ * startTrace() records every add, findAge and
+ * clear of a list to a file, so a replay can
+ * run real traffic against each policy (see
+ * trace-replay-benchmark.c). Each record is a
+ * varint holding (value << 2) | op:
+ *
+ *   TRACE_ADD    value is the name length,
+ *                then the name and the age
+ *                as a zigzag varint follow.
+ *                The name gets the next id.
+ *   TRACE_FIND   a hit. value is the id of
+ *                the name found.
+ *   TRACE_MISS   value is the name length,
+ *                then the name follows.
+ *   TRACE_CLEAR  value is 0. Ids start over.
+ *
+ * A hit, the common case, costs one or two
+ * bytes. Nodes already in the list when the
+ * trace starts are written as adds first,
+ * tail first, so a replay starts from the
+ * same order.
+ *
+ * Built with -DINSTRUMENT, the list also
+ * records the depth of every findAge in the
+ * list.find_scanned histogram, and counts
+ * list.misses, list.reorders and the
+ * list.arena_chunks it mallocs.
+ *
  */
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "../instrumentation/instrumentation.h"
+
+#define NAME_SIZE 16 // Longest inline name is NAME_SIZE - 1.
+#define LONG_NAME_MARK ((char) 0xff) // Last byte of a long name's field.
+#define ARENA_CHUNK_SIZE 16384
+#define ARENA_ALIGNMENT 8
+#define DEFAULT_MOVE_AHEAD_K 4
+#define ADAPTIVE_WINDOW 256 // Lookups per measurement.
+#define ADAPTIVE_EXPLOIT_WINDOWS 32 // Windows before trying all again.
+#define TRACE_MAGIC "SOLT"
+#define TRACE_VERSION 1
+
+typedef enum policy {
+    MOVE_TO_FRONT,
+    TRANSPOSE,
+    COUNT,
+    MOVE_AHEAD_K,
+    ADAPTIVE
+} policy;
+
+#define ADAPTIVE_CANDIDATES 4 // The policies before ADAPTIVE.
+
+typedef enum trace_op {
+    TRACE_ADD,
+    TRACE_FIND,
+    TRACE_MISS,
+    TRACE_CLEAR
+} trace_op;
+
 typedef struct node {
-    char name[10];
+    uint32_t hash; // Hash of name.
     int age;
     struct node* next;
+    int count; // Successful lookups, for COUNT.
+    uint32_t trace_id; // Id of the name in the trace.
+    char name[NAME_SIZE]; // Zero padded, or see LONG_NAME_MARK.
 } node;
 
+typedef struct long_name {
+    uint32_t length;
+    char bytes[]; // Zero terminated.
+} long_name;
+
+typedef struct arena_chunk {
+    struct arena_chunk* next;
+    size_t size; // Bytes in data.
+    _Alignas(ARENA_ALIGNMENT) char data[];
+} arena_chunk;
+
+typedef struct arena {
+    arena_chunk* first;
+    arena_chunk* current; // Chunk being handed out.
+    size_t used; // Bytes handed out from current.
+} arena;
+
+typedef struct adaptive_state {
+    policy active; // Policy in use right now.
+    int exploring; // 1 while trying each policy.
+    int window_lookups;
+    long window_scanned;
+    double average[ADAPTIVE_CANDIDATES]; // Last measured depth.
+    int windows_left; // Windows until exploring again.
+} adaptive_state;
+
 typedef struct list {
     node* head;
+    policy policy;
+    int move_ahead_k;
+    adaptive_state adaptive;
+    long lookups; // Calls to findAge.
+    long nodes_scanned; // Nodes looked at by findAge.
+    long reorders; // Lookups that changed the order.
+    arena arena; // Nodes and long names.
+    FILE* trace; // NULL when not tracing.
+    uint32_t next_trace_id;
 } list;
 
-void add(list*, char*, int);
-int findAge(list*, char*);
+void add(list*, const char*, int);
+int findAge(list*, const char*, int*);
+void setPolicy(list*, policy, int);
 void moveToFront(list*, node*, node*);
+void transpose(list*, node*, node*, node*);
+void moveByCount(list*, node*, node*);
+void moveAheadK(list*, node*, node*, int, int);
 void printList(list*);
+void printStats(list*, const char*);
 void clear(list*);
+int startTrace(list*, const char*);
+void stopTrace(list*);
 
-node* createNode(char*, int);
+void freeList(list*);
+node* createNode(list*, const char*, int);
+size_t padName(char*, const char*);
+uint32_t hashName(const char*, const char*, size_t);
+int namesEqual(const char*, const char*);
+const char* nodeName(node*);
+int longNameEquals(node*, const char*, size_t);
+void* arenaAlloc(arena*, size_t);
+void arenaReset(arena*);
+void arenaFree(arena*);
+void traceRecord(list*, trace_op, uint64_t);
+void writeVarint(FILE*, uint64_t);
+int reorganize(list*, policy, node*, node*, node*, int);
+void adapt(list*, int);
+void compareWorkload(policy, const char*);
 
 int main() {
     list* family = calloc(1, sizeof(list));
@@ -50,22 +221,37 @@ int main() {
     add(family, "Rosco", 12);
     add(family, "Cal", 10);
     add(family, "Trish", 7);
+    add(family, "Bartholomew Montgomery", 81);
 
     printList(family);
 
-    findAge(family, "Trish");
-    findAge(family, "Cal");
-    findAge(family, "Rosco");
-    findAge(family, "Martha");
-    findAge(family, "John");
+    int scanned;
+    findAge(family, "Trish", &scanned);
+    printf("Trish found after %d nodes\n", scanned);
+    findAge(family, "Cal", NULL);
+    findAge(family, "Rosco", NULL);
+    findAge(family, "Martha", NULL);
+    findAge(family, "John", &scanned);
+    printf("John found after %d nodes\n", scanned);
+    printf("Bartholomew Montgomery is %d\n\n",
+           findAge(family, "Bartholomew Montgomery", NULL));
 
     printList(family);
 
-    clear(family);
-
-    free(family);
+    freeList(family);
     family = NULL;
 
+    // The same skewed, shifting lookups
+    // against each policy.
+    printf("%-14s %12s %10s\n", "Policy", "avg scanned", "reorders");
+    compareWorkload(MOVE_TO_FRONT, "move-to-front");
+    compareWorkload(TRANSPOSE, "transpose");
+    compareWorkload(COUNT, "count");
+    compareWorkload(MOVE_AHEAD_K, "move-ahead-4");
+    compareWorkload(ADAPTIVE, "adaptive");
+
+    INSTRUMENT_DUMP(stdout);
+
     return 0;
 }
 
@@ -73,44 +259,110 @@ int main() {
 /// \param list
 /// \param name
 /// \param age
-void add(list* list, char* name, int age) {
-    node* new_node = createNode(name, age);
+void add(list* list, const char* name, int age) {
+    node* new_node = createNode(list, name, age);
+    if (new_node == NULL)
+        return;
+
     new_node->next = list->head;
     list->head = new_node;
+
+    if (list->trace != NULL) {
+        size_t length = strlen(name);
+        new_node->trace_id = list->next_trace_id++;
+        traceRecord(list, TRACE_ADD, length);
+        fwrite(name, 1, length, list->trace);
+        writeVarint(list->trace, ((uint32_t) age << 1) ^ (uint32_t) (age >> 31));
+    }
 }
 
-/// Finds the age of the family member.
+/// Finds the age of the family member and
+/// reorganizes the list by its policy.
 /// \param list
 /// \param name
+/// \param nodes_scanned receives the number of nodes
+/// looked at, may be NULL
 /// \return age, or -1 if not found
-int findAge(list* list, char* name) {
-    // Keep track of the previous node,
-    // so we can use it in moveToFront
-    // call to simplify re-organizing
-    // the list.
+int findAge(list* list, const char* name, int* nodes_scanned) {
+    // Keep track of the two previous nodes,
+    // so the reorganizing functions do not
+    // have to search for them again.
     int age_found = -1;
+    int scanned = 0;
+    node* before_previous_node = NULL;
     node* previous_node = NULL;
     node* current_node = list->head;
 
+    char padded_name[NAME_SIZE];
+    size_t length = padName(padded_name, name);
+    uint32_t name_hash = hashName(padded_name, name, length);
+
     // Search for name in the list.
     while (current_node != NULL) {
-        if (strcmp(current_node->name, name) == 0)
+        scanned++;
+        if (current_node->hash == name_hash
+            && namesEqual(current_node->name, padded_name)
+            && (length < NAME_SIZE || longNameEquals(current_node, name, length)))
             break;
+        before_previous_node = previous_node;
         previous_node = current_node;
         current_node = current_node->next;
     }
 
-    // The name is found. Move the node
-    // associated with the name to the
-    // head of the list.
+    list->lookups++;
+    list->nodes_scanned += scanned;
+    INSTRUMENT_RECORD(list, find_scanned, scanned);
+
+    // The name is found. Reorganize the
+    // list around the node.
     if (current_node != NULL) {
-        moveToFront(list, previous_node, current_node);
+        policy active = list->policy == ADAPTIVE ? list->adaptive.active : list->policy;
+
+        if (reorganize(list, active, before_previous_node, previous_node,
+                       current_node, scanned - 1)) {
+            list->reorders++;
+            INSTRUMENT_COUNT(list, reorders, 1);
+        }
+
         age_found = current_node->age;
+    } else
+        INSTRUMENT_COUNT(list, misses, 1);
+
+    if (list->trace != NULL) {
+        if (current_node != NULL) {
+            traceRecord(list, TRACE_FIND, current_node->trace_id);
+        } else {
+            traceRecord(list, TRACE_MISS, length);
+            fwrite(name, 1, length, list->trace);
+        }
     }
 
+    if (list->policy == ADAPTIVE)
+        adapt(list, scanned);
+
+    if (nodes_scanned != NULL)
+        *nodes_scanned = scanned;
+
     return age_found;
 }
 
+/// Sets how the list reorganizes itself. The
+/// list keeps its current order.
+/// \param list
+/// \param new_policy
+/// \param k places to move for MOVE_AHEAD_K, or 0
+/// for DEFAULT_MOVE_AHEAD_K
+void setPolicy(list* list, policy new_policy, int k) {
+    list->policy = new_policy;
+    list->move_ahead_k = k;
+
+    // Start adaptive mode by trying
+    // every policy once.
+    memset(&list->adaptive, 0, sizeof(adaptive_state));
+    list->adaptive.active = MOVE_TO_FRONT;
+    list->adaptive.exploring = 1;
+}
+
 /// Moves node to the head of the list.
 /// \param list
 /// \param previous_node
@@ -126,39 +378,509 @@ void moveToFront(list* list, node* previous_node, node* node) {
     list->head = node;
 }
 
-/// Clears the list of any items.
+/// Swaps node with the node in front of it.
 /// \param list
-void clear(list* list) {
-    node* current_node = list->head;
-    node* next_node;
+/// \param before_previous_node
+/// \param previous_node
+/// \param node
+void transpose(list* list, node* before_previous_node, node* previous_node, node* node) {
+    // It's at the front of the list.
+    // Do nothing.
+    if (previous_node == NULL)
+        return;
 
-    while (current_node != NULL) {
-        next_node = current_node->next;
-        free(current_node);
-        current_node = next_node;
+    previous_node->next = node->next;
+    node->next = previous_node;
+
+    if (before_previous_node == NULL)
+        list->head = node;
+    else
+        before_previous_node->next = node;
+}
+
+/// Counts a lookup of node and moves it in front
+/// of the first node with a lower count.
+/// \param list
+/// \param previous_node
+/// \param node
+void moveByCount(list* list, node* previous_node, node* node) {
+    node->count++;
+
+    // Find the first node with a lower count.
+    struct node* before_target = NULL;
+    struct node* target = list->head;
+
+    while (target != node && target->count >= node->count) {
+        before_target = target;
+        target = target->next;
     }
 
+    // Nothing in front of it has a lower count.
+    if (target == node)
+        return;
+
+    previous_node->next = node->next;
+    node->next = target;
+
+    if (before_target == NULL)
+        list->head = node;
+    else
+        before_target->next = node;
+}
+
+/// Moves node k places towards the head of the
+/// list, or to the head if it is closer than that.
+/// \param list
+/// \param previous_node
+/// \param node
+/// \param position index of node, 0 for the head
+/// \param k
+void moveAheadK(list* list, node* previous_node, node* node, int position, int k) {
+    if (position == 0)
+        return;
+
+    int target = position > k ? position - k : 0;
+
+    if (target == 0) {
+        moveToFront(list, previous_node, node);
+        return;
+    }
+
+    // Walk to the node just before the target position.
+    struct node* before_target = list->head;
+    for (int i = 1; i < target; i++)
+        before_target = before_target->next;
+
+    previous_node->next = node->next;
+    node->next = before_target->next;
+    before_target->next = node;
+}
+
+/// Clears the list of any items. The arena keeps
+/// its chunks for the next adds.
+/// \param list
+void clear(list* list) {
     list->head = NULL;
+    arenaReset(&list->arena);
+
+    if (list->trace != NULL) {
+        traceRecord(list, TRACE_CLEAR, 0);
+        list->next_trace_id = 0;
+    }
+}
+
+/// Starts recording the operations on the list to a
+/// trace file. The nodes already in the list are
+/// recorded as adds.
+/// \param list
+/// \param path
+/// \return 1 on success, 0 if the file cannot be created
+int startTrace(list* list, const char* path) {
+    stopTrace(list);
+
+    FILE* trace = fopen(path, "wb");
+    if (trace == NULL) {
+        printf("Error: Cannot create trace %s.\n", path);
+        return 0;
+    }
+
+    fwrite(TRACE_MAGIC, 1, 4, trace);
+    fputc(TRACE_VERSION, trace);
+
+    // Collect the nodes so they can be
+    // recorded from the tail.
+    size_t count = 0;
+    for (node* current_node = list->head; current_node != NULL; current_node = current_node->next)
+        count++;
+
+    node** nodes = malloc((count ? count : 1) * sizeof(node*));
+    count = 0;
+    for (node* current_node = list->head; current_node != NULL; current_node = current_node->next)
+        nodes[count++] = current_node;
+
+    list->trace = trace;
+    list->next_trace_id = 0;
+
+    while (count > 0) {
+        node* current_node = nodes[--count];
+        const char* name = nodeName(current_node);
+        size_t length = strlen(name);
+        int age = current_node->age;
+
+        current_node->trace_id = list->next_trace_id++;
+        traceRecord(list, TRACE_ADD, length);
+        fwrite(name, 1, length, trace);
+        writeVarint(trace, ((uint32_t) age << 1) ^ (uint32_t) (age >> 31));
+    }
+
+    free(nodes);
+
+    return 1;
+}
+
+/// Stops recording and closes the trace file.
+/// \param list
+void stopTrace(list* list) {
+    if (list->trace == NULL)
+        return;
+
+    fclose(list->trace);
+    list->trace = NULL;
 }
 
 /// Prints the names of all people in the list.
 void printList(list* list) {
     node* current_node = list->head;
     while (current_node != NULL) {
-        printf("%10s", current_node->name);
+        printf("%10s", nodeName(current_node));
         current_node = current_node->next;
     }
     printf("\n\n");
 }
 
-/// Creates and returns a new node with
-/// the proper name and age.
+/// Prints the average search depth and the number
+/// of reorders of the list.
+/// \param list
+/// \param label
+void printStats(list* list, const char* label) {
+    double average = list->lookups ? (double) list->nodes_scanned / list->lookups : 0;
+    printf("%-14s %12.2f %10ld\n", label, average, list->reorders);
+}
+
+/// Frees the list and its arena.
+/// \param list
+void freeList(list* list) {
+    stopTrace(list);
+    arenaFree(&list->arena);
+    free(list);
+}
+
+/// Creates and returns a new node with the proper
+/// name and age, in the list's arena. A long name
+/// is stored right after the node.
+/// \param list
 /// \param name
 /// \param age
-/// \return a new node
-node* createNode(char* name, int age) {
-    node* new_node = calloc(1, sizeof(node));
-    strcpy(new_node->name, name);
+/// \return a new node, or NULL if out of memory
+node* createNode(list* list, const char* name, int age) {
+    char padded_name[NAME_SIZE];
+    size_t length = padName(padded_name, name);
+
+    size_t size = sizeof(node);
+    if (length >= NAME_SIZE)
+        size += sizeof(long_name) + length + 1;
+
+    node* new_node = arenaAlloc(&list->arena, size);
+    if (new_node == NULL) {
+        printf("Error: Out of memory adding %s.\n", name);
+        return NULL;
+    }
+
+    memcpy(new_node->name, padded_name, NAME_SIZE);
+    new_node->hash = hashName(padded_name, name, length);
     new_node->age = age;
+    new_node->next = NULL;
+    new_node->count = 0;
+
+    if (length >= NAME_SIZE) {
+        long_name* full_name = (long_name*) (new_node + 1);
+        full_name->length = (uint32_t) length;
+        memcpy(full_name->bytes, name, length + 1);
+    }
+
     return new_node;
 }
+
+/// Copies name into a NAME_SIZE buffer and fills
+/// the rest of it with zeros. A long name keeps its
+/// first NAME_SIZE - 1 characters and LONG_NAME_MARK.
+/// \param padded receives the padded name
+/// \param name
+/// \return length of name
+size_t padName(char* padded, const char* name) {
+    size_t length = strlen(name);
+
+    memset(padded, 0, NAME_SIZE);
+
+    if (length < NAME_SIZE) {
+        memcpy(padded, name, length);
+    } else {
+        memcpy(padded, name, NAME_SIZE - 1);
+        padded[NAME_SIZE - 1] = LONG_NAME_MARK;
+    }
+
+    return length;
+}
+
+/// Hashes a padded name by mixing its two
+/// 64-bit halves, no loop over the characters.
+/// The rest of a long name is mixed in too.
+/// \param padded
+/// \param name
+/// \param length length of name
+/// \return the hash
+uint32_t hashName(const char* padded, const char* name, size_t length) {
+    uint64_t low, high;
+    memcpy(&low, padded, 8);
+    memcpy(&high, padded + 8, 8);
+
+    uint64_t hash = low * 0x9e3779b97f4a7c15u;
+    hash ^= high + (hash >> 29);
+
+    for (size_t i = NAME_SIZE - 1; i < length; i++)
+        hash = (hash ^ (unsigned char) name[i]) * 0x100000001b3u;
+
+    hash *= 0xbf58476d1ce4e5b9u;
+    hash ^= hash >> 32;
+
+    return (uint32_t) hash;
+}
+
+/// Compares two padded names.
+/// \param a
+/// \param b
+/// \return 1 if equal, otherwise 0
+int namesEqual(const char* a, const char* b) {
+#ifdef __SSE2__
+    __m128i bytes_a = _mm_loadu_si128((const __m128i*) a);
+    __m128i bytes_b = _mm_loadu_si128((const __m128i*) b);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(bytes_a, bytes_b)) == 0xffff;
+#else
+    uint64_t a_words[2], b_words[2];
+    memcpy(a_words, a, NAME_SIZE);
+    memcpy(b_words, b, NAME_SIZE);
+    return ((a_words[0] ^ b_words[0]) | (a_words[1] ^ b_words[1])) == 0;
+#endif
+}
+
+/// Returns the whole name of a node.
+/// \param node
+/// \return the zero terminated name
+const char* nodeName(node* node) {
+    if (node->name[NAME_SIZE - 1] != LONG_NAME_MARK)
+        return node->name;
+
+    return ((long_name*) (node + 1))->bytes;
+}
+
+/// Compares the long name stored after a node
+/// with name.
+/// \param node
+/// \param name
+/// \param length length of name
+/// \return 1 if equal, otherwise 0
+int longNameEquals(node* node, const char* name, size_t length) {
+    long_name* full_name = (long_name*) (node + 1);
+    return full_name->length == length && memcmp(full_name->bytes, name, length) == 0;
+}
+
+/// Hands out size bytes from the arena. Moves on to
+/// the next chunk when the current one is full, reusing
+/// chunks kept by arenaReset, and adds a chunk when
+/// there is none big enough.
+/// \param arena
+/// \param size
+/// \return the memory, or NULL if out of memory
+void* arenaAlloc(arena* arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+
+    if (arena->current == NULL || arena->used + size > arena->current->size) {
+        arena_chunk* next_chunk = arena->current != NULL ? arena->current->next : NULL;
+
+        if (next_chunk == NULL || next_chunk->size < size) {
+            size_t chunk_size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+            arena_chunk* new_chunk = malloc(sizeof(arena_chunk) + chunk_size);
+            if (new_chunk == NULL)
+                return NULL;
+
+            INSTRUMENT_COUNT(list, arena_chunks, 1);
+
+            new_chunk->size = chunk_size;
+            new_chunk->next = next_chunk;
+
+            if (arena->current != NULL)
+                arena->current->next = new_chunk;
+            else
+                arena->first = new_chunk;
+
+            next_chunk = new_chunk;
+        }
+
+        arena->current = next_chunk;
+        arena->used = 0;
+    }
+
+    void* memory = arena->current->data + arena->used;
+    arena->used += size;
+
+    return memory;
+}
+
+/// Takes back everything the arena handed out,
+/// keeping its chunks.
+/// \param arena
+void arenaReset(arena* arena) {
+    arena->current = arena->first;
+    arena->used = 0;
+}
+
+/// Frees all chunks of the arena.
+/// \param arena
+void arenaFree(arena* arena) {
+    arena_chunk* chunk = arena->first;
+
+    while (chunk != NULL) {
+        arena_chunk* next_chunk = chunk->next;
+        free(chunk);
+        chunk = next_chunk;
+    }
+
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->used = 0;
+}
+
+/// Writes the varint that starts a trace record.
+/// \param list
+/// \param op
+/// \param value name id or length
+void traceRecord(list* list, trace_op op, uint64_t value) {
+    writeVarint(list->trace, (value << 2) | op);
+}
+
+/// Writes a number 7 bits at a time, low bits
+/// first, with the top bit set on all but the
+/// last byte.
+/// \param file
+/// \param value
+void writeVarint(FILE* file, uint64_t value) {
+    while (value >= 0x80) {
+        fputc((int) (value & 0x7f) | 0x80, file);
+        value >>= 7;
+    }
+    fputc((int) value, file);
+}
+
+/// Applies a policy to a node that was just found.
+/// \param list
+/// \param active the policy to apply
+/// \param before_previous_node
+/// \param previous_node
+/// \param node
+/// \param position index of node, 0 for the head
+/// \return 1 if the order changed, otherwise 0
+int reorganize(list* list, policy active, node* before_previous_node,
+               node* previous_node, node* node, int position) {
+    struct node* old_head = list->head;
+    struct node* old_previous_next = previous_node ? previous_node->next : NULL;
+
+    switch (active) {
+        case TRANSPOSE:
+            transpose(list, before_previous_node, previous_node, node);
+            break;
+        case COUNT:
+            moveByCount(list, previous_node, node);
+            break;
+        case MOVE_AHEAD_K:
+            moveAheadK(list, previous_node, node, position,
+                       list->move_ahead_k > 0 ? list->move_ahead_k : DEFAULT_MOVE_AHEAD_K);
+            break;
+        case MOVE_TO_FRONT:
+        case ADAPTIVE:
+        default:
+            moveToFront(list, previous_node, node);
+            break;
+    }
+
+    // Every policy that moves the node
+    // unlinks it from previous_node.
+    return list->head != old_head
+           || (previous_node != NULL && previous_node->next != old_previous_next);
+}
+
+/// Records the depth of a lookup in adaptive mode
+/// and switches policy at the end of a window.
+/// \param list
+/// \param scanned nodes looked at by the lookup
+void adapt(list* list, int scanned) {
+    adaptive_state* state = &list->adaptive;
+
+    state->window_lookups++;
+    state->window_scanned += scanned;
+
+    if (state->window_lookups < ADAPTIVE_WINDOW)
+        return;
+
+    double average = (double) state->window_scanned / state->window_lookups;
+    state->window_lookups = 0;
+    state->window_scanned = 0;
+
+    if (state->exploring) {
+        state->average[state->active] = average;
+
+        // Try the next policy, or settle on the
+        // best one once all have had a window.
+        if (state->active + 1 < ADAPTIVE_CANDIDATES) {
+            state->active++;
+            return;
+        }
+
+        policy best = MOVE_TO_FRONT;
+        for (int i = 1; i < ADAPTIVE_CANDIDATES; i++) {
+            if (state->average[i] < state->average[best])
+                best = i;
+        }
+
+        state->active = best;
+        state->exploring = 0;
+        state->windows_left = ADAPTIVE_EXPLOIT_WINDOWS;
+        return;
+    }
+
+    // The pattern changed enough that the chosen
+    // policy got much worse. Explore again early.
+    state->windows_left--;
+    if (state->windows_left <= 0 || average > 1.5 * state->average[state->active] + 1) {
+        state->active = MOVE_TO_FRONT;
+        state->exploring = 1;
+    }
+}
+
+/// Runs the same lookups against a list using the
+/// given policy and prints its stats. 200 names are
+/// looked up with a skew towards a few of them, and
+/// the popular names change halfway through.
+/// \param active
+/// \param label
+void compareWorkload(policy active, const char* label) {
+    const int names = 200;
+    const int lookups = 200000;
+    char name[NAME_SIZE];
+
+    list* people = calloc(1, sizeof(list));
+    setPolicy(people, active, DEFAULT_MOVE_AHEAD_K);
+
+    for (int i = 0; i < names; i++) {
+        sprintf(name, "name%d", i);
+        add(people, name, i);
+    }
+
+    srand(42);
+
+    for (int i = 0; i < lookups; i++) {
+        // The product of two uniform numbers
+        // favours small indexes.
+        int index = (rand() % names) * (rand() % names) / names;
+
+        // Shift the popular names halfway through.
+        if (i >= lookups / 2)
+            index = (index + names / 2) % names;
+
+        sprintf(name, "name%d", index);
+        findAge(people, name, NULL);
+    }
+
+    printStats(people, label);
+
+    freeList(people);
+}
@@ -0,0 +1,659 @@
+/*
+ *
+ * Self-Organizing List Trace Replay Benchmark
+ *
+ *    Measures:
+ *      average search depth, ns per lookup and
+ *      reorders, for each policy of
+ *      self-organizing-list.c, an unordered list
+ *      and a hash map
+ *
+ *    Options:
+ *      -t trace      replay a trace written by startTrace()
+ *      -w workload   zipf, uniform or phase (default zipf)
+ *      -n names      distinct names (default 1000)
+ *      -l lookups    lookups to generate (default 1000000)
+ *      -s skew       zipf exponent (default 1.0)
+ *      -p phases     times the popular names change, for
+ *                    phase (default 4)
+ *      -o trace      also record the workload to a trace,
+ *                    while replaying it with move-to-front
+ *
+ *    Build:
+ *      gcc -O2 trace-replay-benchmark.c -lm
+ *
+ * Notes:
+ *
+ * The five-name demo in self-organizing-list.c says little
+ * about how a policy does on real traffic. Record the traffic
+ * with startTrace() on the list in use, then replay the trace
+ * here against every structure:
+ *
+ *   ./a.out -t family.trace
+ *
+ * Without -t, a synthetic workload is generated: all names
+ * are added in random order, then looked up with a Zipf
+ * distribution, with equal odds (uniform), or with a Zipf
+ * distribution whose popular names move every lookups/phases
+ * lookups (phase).
+ *
+ * self-organizing-list.c is included with its main() renamed.
+ * The unordered list is the same list searched without ever
+ * reorganizing it, so the difference is the effect of the
+ * policy alone. The hash map chains the same nodes, so its
+ * depth is the number of nodes in a bucket it looked at.
+ *
+ * The time is for the whole replay, adds included, divided
+ * by the number of lookups. Synthetic workloads have far
+ * fewer adds than lookups.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#define main self_organizing_list_main
+#include "self-organizing-list.c"
+#undef main
+
+#define DEFAULT_NAMES 1000
+#define DEFAULT_LOOKUPS 1000000
+#define DEFAULT_SKEW 1.0
+#define DEFAULT_PHASES 4
+#define MAX_TRACE_NAME 65536 // Longer means a damaged trace.
+
+typedef struct operation {
+    trace_op op; // TRACE_ADD, TRACE_FIND or TRACE_CLEAR.
+    uint32_t name; // Index into names.
+    int age;
+} operation;
+
+typedef struct workload {
+    char** names;
+    size_t name_count;
+    size_t name_capacity;
+    operation* operations;
+    size_t count;
+    size_t capacity;
+    long lookups;
+} workload;
+
+typedef struct hash_map {
+    node** buckets;
+    size_t mask; // Number of buckets - 1.
+    size_t count;
+    list storage; // Only its arena is used.
+    long lookups;
+    long nodes_scanned;
+} hash_map;
+
+// Workloads
+int loadTrace(workload*, const char*);
+void generateWorkload(workload*, const char*, int, long, double, int);
+uint32_t addName(workload*, const char*, size_t);
+void addOperation(workload*, trace_op, uint32_t, int);
+void freeWorkload(workload*);
+int readVarint(FILE*, uint64_t*);
+uint64_t nextRandom(uint64_t*);
+
+// Replays
+void replayList(workload*, policy, const char*, const char*);
+void replayUnordered(workload*);
+void replayHashMap(workload*);
+int findUnordered(list*, const char*, int*);
+void mapAdd(hash_map*, const char*, int);
+int mapFind(hash_map*, const char*);
+void mapClear(hash_map*);
+double secondsSince(struct timespec*);
+void printResult(const char*, double, double, long);
+
+int main(int argc, char* argv[]) {
+    const char* trace_path = NULL;
+    const char* record_path = NULL;
+    const char* kind = "zipf";
+    int names = DEFAULT_NAMES;
+    long lookups = DEFAULT_LOOKUPS;
+    double skew = DEFAULT_SKEW;
+    int phases = DEFAULT_PHASES;
+    int option;
+
+    while ((option = getopt(argc, argv, "t:w:n:l:s:p:o:")) != -1) {
+        switch (option) {
+            case 't': trace_path = optarg; break;
+            case 'w': kind = optarg; break;
+            case 'n': names = atoi(optarg); break;
+            case 'l': lookups = atol(optarg); break;
+            case 's': skew = atof(optarg); break;
+            case 'p': phases = atoi(optarg); break;
+            case 'o': record_path = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [-t trace] [-w zipf|uniform|phase] [-n names]"
+                                " [-l lookups] [-s skew] [-p phases] [-o trace]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (names < 1 || lookups < 0 || phases < 1) {
+        fprintf(stderr, "Error: names and phases must be positive.\n");
+        return 1;
+    }
+
+    workload work = {0};
+
+    if (trace_path != NULL) {
+        if (!loadTrace(&work, trace_path))
+            return 1;
+        printf("Trace %s: %zu names, %ld lookups\n\n", trace_path, work.name_count, work.lookups);
+    } else if (strcmp(kind, "zipf") == 0 || strcmp(kind, "uniform") == 0
+               || strcmp(kind, "phase") == 0) {
+        generateWorkload(&work, kind, names, lookups, skew, phases);
+        printf("Workload %s: %d names, %ld lookups\n\n", kind, names, lookups);
+    } else {
+        fprintf(stderr, "Error: Unknown workload %s.\n", kind);
+        return 1;
+    }
+
+    if (work.lookups == 0) {
+        printf("Nothing to replay.\n");
+        freeWorkload(&work);
+        return 0;
+    }
+
+    printf("%-14s %10s %10s %10s\n", "Structure", "avg depth", "ns/lookup", "reorders");
+
+    replayList(&work, MOVE_TO_FRONT, "move-to-front", record_path);
+    replayList(&work, TRANSPOSE, "transpose", NULL);
+    replayList(&work, COUNT, "count", NULL);
+    replayList(&work, MOVE_AHEAD_K, "move-ahead-4", NULL);
+    replayList(&work, ADAPTIVE, "adaptive", NULL);
+    replayUnordered(&work);
+    replayHashMap(&work);
+
+    freeWorkload(&work);
+
+    return 0;
+}
+
+/*
+ *
+ * Workloads
+ *
+ */
+
+/// Reads a trace written by startTrace().
+/// \param work receives the operations
+/// \param path
+/// \return 1 on success, 0 if the file is missing or
+/// not a valid trace
+int loadTrace(workload* work, const char* path) {
+    FILE* trace = fopen(path, "rb");
+    if (trace == NULL) {
+        fprintf(stderr, "Error: Cannot open trace %s.\n", path);
+        return 0;
+    }
+
+    char magic[4];
+    if (fread(magic, 1, 4, trace) != 4 || memcmp(magic, TRACE_MAGIC, 4) != 0
+        || fgetc(trace) != TRACE_VERSION) {
+        fprintf(stderr, "Error: %s is not a trace.\n", path);
+        fclose(trace);
+        return 0;
+    }
+
+    // Trace ids are the order of the adds since
+    // the last clear. Map them to name indexes.
+    uint32_t* ids = NULL;
+    size_t id_count = 0;
+    size_t id_capacity = 0;
+    char* name = NULL;
+    size_t name_capacity = 0;
+    int valid = 1;
+    uint64_t record;
+
+    while (valid && readVarint(trace, &record)) {
+        trace_op op = (trace_op) (record & 3);
+        uint64_t value = record >> 2;
+
+        if (op == TRACE_FIND) {
+            if (value >= id_count) {
+                valid = 0;
+                break;
+            }
+            addOperation(work, TRACE_FIND, ids[value], 0);
+            continue;
+        }
+
+        if (op == TRACE_CLEAR) {
+            id_count = 0;
+            addOperation(work, TRACE_CLEAR, 0, 0);
+            continue;
+        }
+
+        // An add or a miss. The name follows.
+        if (value > MAX_TRACE_NAME) {
+            valid = 0;
+            break;
+        }
+
+        if (value + 1 > name_capacity) {
+            name_capacity = value + 1;
+            name = realloc(name, name_capacity);
+        }
+
+        if (fread(name, 1, value, trace) != value) {
+            valid = 0;
+            break;
+        }
+        name[value] = '\0';
+
+        uint32_t index = addName(work, name, value);
+
+        if (op == TRACE_MISS) {
+            addOperation(work, TRACE_FIND, index, 0);
+            continue;
+        }
+
+        uint64_t zigzag;
+        if (!readVarint(trace, &zigzag)) {
+            valid = 0;
+            break;
+        }
+
+        if (id_count == id_capacity) {
+            id_capacity = id_capacity ? id_capacity * 2 : 1024;
+            ids = realloc(ids, id_capacity * sizeof(uint32_t));
+        }
+        ids[id_count++] = index;
+
+        addOperation(work, TRACE_ADD, index, (int) ((zigzag >> 1) ^ -(zigzag & 1)));
+    }
+
+    if (!valid || ferror(trace))
+        fprintf(stderr, "Error: %s is damaged. Replaying the %zu operations before it.\n",
+                path, work->count);
+
+    free(ids);
+    free(name);
+    fclose(trace);
+
+    return 1;
+}
+
+/// Generates a synthetic workload. All names are
+/// added in random order, then looked up.
+/// \param work receives the operations
+/// \param kind zipf, uniform or phase
+/// \param names
+/// \param lookups
+/// \param skew zipf exponent
+/// \param phases
+void generateWorkload(workload* work, const char* kind, int names, long lookups,
+                      double skew, int phases) {
+    uint64_t random = 0x2545f4914f6cdd1du;
+    char name[NAME_SIZE];
+
+    for (int i = 0; i < names; i++) {
+        int length = sprintf(name, "name%d", i);
+        addName(work, name, length);
+    }
+
+    // Shuffle the adding order, so the
+    // popular names are not all in front.
+    uint32_t* order = malloc(names * sizeof(uint32_t));
+    for (int i = 0; i < names; i++)
+        order[i] = i;
+    for (int i = names - 1; i > 0; i--) {
+        int j = (int) (nextRandom(&random) % (i + 1));
+        uint32_t swap = order[i];
+        order[i] = order[j];
+        order[j] = swap;
+    }
+
+    for (int i = 0; i < names; i++)
+        addOperation(work, TRACE_ADD, order[i], order[i]);
+
+    // Name i has a chance proportional to 1 / (i + 1)^skew.
+    // cumulative[i] is the chance of picking names 0 to i.
+    double* cumulative = malloc(names * sizeof(double));
+    double total = 0;
+    for (int i = 0; i < names; i++) {
+        total += 1.0 / pow(i + 1, skew);
+        cumulative[i] = total;
+    }
+
+    int uniform = strcmp(kind, "uniform") == 0;
+    int shifting = strcmp(kind, "phase") == 0;
+    long phase_length = lookups / phases + 1;
+
+    for (long i = 0; i < lookups; i++) {
+        uint32_t rank;
+
+        if (uniform) {
+            rank = (uint32_t) (nextRandom(&random) % names);
+        } else {
+            // Binary search for the first cumulative
+            // chance above a random point.
+            double point = (nextRandom(&random) >> 11) * (1.0 / 9007199254740992.0) * total;
+            uint32_t low = 0, high = names - 1;
+            while (low < high) {
+                uint32_t middle = (low + high) / 2;
+                if (cumulative[middle] > point)
+                    high = middle;
+                else
+                    low = middle + 1;
+            }
+            rank = low;
+        }
+
+        // In each phase a different part of the
+        // names is popular.
+        if (shifting)
+            rank = (uint32_t) ((rank + i / phase_length * names / phases) % names);
+
+        addOperation(work, TRACE_FIND, rank, 0);
+    }
+
+    free(cumulative);
+    free(order);
+}
+
+/// Stores a copy of a name.
+/// \param work
+/// \param name
+/// \param length
+/// \return index of the name
+uint32_t addName(workload* work, const char* name, size_t length) {
+    if (work->name_count == work->name_capacity) {
+        work->name_capacity = work->name_capacity ? work->name_capacity * 2 : 1024;
+        work->names = realloc(work->names, work->name_capacity * sizeof(char*));
+    }
+
+    char* copy = malloc(length + 1);
+    memcpy(copy, name, length + 1);
+    work->names[work->name_count] = copy;
+
+    return (uint32_t) work->name_count++;
+}
+
+/// Appends an operation.
+/// \param work
+/// \param op
+/// \param name index of the name
+/// \param age
+void addOperation(workload* work, trace_op op, uint32_t name, int age) {
+    if (work->count == work->capacity) {
+        work->capacity = work->capacity ? work->capacity * 2 : 4096;
+        work->operations = realloc(work->operations, work->capacity * sizeof(operation));
+    }
+
+    work->operations[work->count++] = (operation) {op, name, age};
+
+    if (op == TRACE_FIND)
+        work->lookups++;
+}
+
+/// Frees the names and operations.
+/// \param work
+void freeWorkload(workload* work) {
+    for (size_t i = 0; i < work->name_count; i++)
+        free(work->names[i]);
+
+    free(work->names);
+    free(work->operations);
+}
+
+/// Reads a number written by writeVarint().
+/// \param file
+/// \param value receives the number
+/// \return 1 on success, 0 at the end of the file
+int readVarint(FILE* file, uint64_t* value) {
+    *value = 0;
+
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = fgetc(file);
+        if (byte == EOF)
+            return 0;
+
+        *value |= (uint64_t) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+/// xorshift64
+/// \param state
+/// \return a random number
+uint64_t nextRandom(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/*
+ *
+ * Replays
+ *
+ */
+
+/// Replays the workload against a self-organizing
+/// list using the given policy.
+/// \param work
+/// \param active
+/// \param label
+/// \param record_path trace to record, or NULL
+void replayList(workload* work, policy active, const char* label, const char* record_path) {
+    list* people = calloc(1, sizeof(list));
+    setPolicy(people, active, DEFAULT_MOVE_AHEAD_K);
+
+    if (record_path != NULL && !startTrace(people, record_path))
+        record_path = NULL;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < work->count; i++) {
+        operation* current = &work->operations[i];
+
+        if (current->op == TRACE_ADD)
+            add(people, work->names[current->name], current->age);
+        else if (current->op == TRACE_FIND)
+            findAge(people, work->names[current->name], NULL);
+        else
+            clear(people);
+    }
+
+    double seconds = secondsSince(&start);
+
+    printResult(label, (double) people->nodes_scanned / people->lookups,
+                seconds * 1e9 / people->lookups, people->reorders);
+
+    if (record_path != NULL) {
+        long size = ftell(people->trace);
+        stopTrace(people);
+        printf("%-14s %ld bytes, %.2f per operation\n", record_path, size,
+               work->count ? (double) size / work->count : 0);
+    }
+
+    freeList(people);
+}
+
+/// Replays the workload against the same list
+/// without ever reorganizing it.
+/// \param work
+void replayUnordered(workload* work) {
+    list* people = calloc(1, sizeof(list));
+    long scanned = 0;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < work->count; i++) {
+        operation* current = &work->operations[i];
+        int depth;
+
+        if (current->op == TRACE_ADD) {
+            add(people, work->names[current->name], current->age);
+        } else if (current->op == TRACE_FIND) {
+            findUnordered(people, work->names[current->name], &depth);
+            scanned += depth;
+        } else {
+            clear(people);
+        }
+    }
+
+    double seconds = secondsSince(&start);
+
+    printResult("unordered", (double) scanned / work->lookups,
+                seconds * 1e9 / work->lookups, 0);
+
+    freeList(people);
+}
+
+/// Replays the workload against a hash map.
+/// \param work
+void replayHashMap(workload* work) {
+    hash_map map = {0};
+    map.mask = 15;
+    map.buckets = calloc(map.mask + 1, sizeof(node*));
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < work->count; i++) {
+        operation* current = &work->operations[i];
+
+        if (current->op == TRACE_ADD)
+            mapAdd(&map, work->names[current->name], current->age);
+        else if (current->op == TRACE_FIND)
+            mapFind(&map, work->names[current->name]);
+        else
+            mapClear(&map);
+    }
+
+    double seconds = secondsSince(&start);
+
+    printResult("hash map", (double) map.nodes_scanned / map.lookups,
+                seconds * 1e9 / map.lookups, 0);
+
+    arenaFree(&map.storage.arena);
+    free(map.buckets);
+}
+
+/// Searches the list like findAge, but leaves
+/// the order alone.
+/// \param list
+/// \param name
+/// \param nodes_scanned receives the number of nodes
+/// looked at
+/// \return age, or -1 if not found
+int findUnordered(list* list, const char* name, int* nodes_scanned) {
+    char padded_name[NAME_SIZE];
+    size_t length = padName(padded_name, name);
+    uint32_t name_hash = hashName(padded_name, name, length);
+    int scanned = 0;
+
+    for (node* current_node = list->head; current_node != NULL;
+         current_node = current_node->next) {
+        scanned++;
+        if (current_node->hash == name_hash
+            && namesEqual(current_node->name, padded_name)
+            && (length < NAME_SIZE || longNameEquals(current_node, name, length))) {
+            *nodes_scanned = scanned;
+            return current_node->age;
+        }
+    }
+
+    *nodes_scanned = scanned;
+    return -1;
+}
+
+/// Adds a name to the map, doubling the buckets
+/// once there are more names than buckets.
+/// \param map
+/// \param name
+/// \param age
+void mapAdd(hash_map* map, const char* name, int age) {
+    node* new_node = createNode(&map->storage, name, age);
+    if (new_node == NULL)
+        return;
+
+    if (map->count > map->mask) {
+        size_t new_mask = map->mask * 2 + 1;
+        node** new_buckets = calloc(new_mask + 1, sizeof(node*));
+
+        for (size_t i = 0; i <= map->mask; i++) {
+            node* current_node = map->buckets[i];
+            while (current_node != NULL) {
+                node* next_node = current_node->next;
+                node** bucket = &new_buckets[current_node->hash & new_mask];
+                current_node->next = *bucket;
+                *bucket = current_node;
+                current_node = next_node;
+            }
+        }
+
+        free(map->buckets);
+        map->buckets = new_buckets;
+        map->mask = new_mask;
+    }
+
+    node** bucket = &map->buckets[new_node->hash & map->mask];
+    new_node->next = *bucket;
+    *bucket = new_node;
+    map->count++;
+}
+
+/// Finds the age of a name in the map.
+/// \param map
+/// \param name
+/// \return age, or -1 if not found
+int mapFind(hash_map* map, const char* name) {
+    char padded_name[NAME_SIZE];
+    size_t length = padName(padded_name, name);
+    uint32_t name_hash = hashName(padded_name, name, length);
+
+    map->lookups++;
+
+    for (node* current_node = map->buckets[name_hash & map->mask]; current_node != NULL;
+         current_node = current_node->next) {
+        map->nodes_scanned++;
+        if (current_node->hash == name_hash
+            && namesEqual(current_node->name, padded_name)
+            && (length < NAME_SIZE || longNameEquals(current_node, name, length)))
+            return current_node->age;
+    }
+
+    return -1;
+}
+
+/// Removes all names from the map.
+/// \param map
+void mapClear(hash_map* map) {
+    memset(map->buckets, 0, (map->mask + 1) * sizeof(node*));
+    map->count = 0;
+    arenaReset(&map->storage.arena);
+}
+
+/// Returns the seconds elapsed since start.
+/// \param start
+/// \return seconds
+double secondsSince(struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/// Prints one row of results.
+/// \param label
+/// \param depth average nodes looked at per lookup
+/// \param nanoseconds per lookup
+/// \param reorders
+void printResult(const char* label, double depth, double nanoseconds, long reorders) {
+    printf("%-14s %10.2f %10.1f %10ld\n", label, depth, nanoseconds, reorders);
+}
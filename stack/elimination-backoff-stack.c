@@ -0,0 +1,448 @@
+/*
+ *
+ * Elimination-Backoff Stack Data Structure
+ *
+ *    Uses:
+ *      Lock-Free Stack, Elimination Array
+ *
+ *    Sample Operations:
+ *      eliminationPush, eliminationPop, eliminationTryPop
+ *
+ *    Build:
+ *      gcc -O2 -mcx16 -pthread elimination-backoff-stack.c
+ *
+ * Notes:
+ *
+ * The lock-free stack in lock-free-stack-using-linked-list.c
+ * still has one top that every thread CASes, so with many
+ * threads most of the time goes into failed CASes. This file
+ * includes that stack and puts an elimination array in front
+ * of it.
+ *
+ * A push followed right away by a pop leaves the stack as it
+ * was, so a push and a pop that happen at the same time can
+ * just hand the value over and skip the stack. Each push or
+ * pop first tries one CAS on the stack. If that fails, the
+ * thread backs off into a random slot of the elimination
+ * array instead of retrying at once:
+ *
+ *   - A push parks its value in an empty slot and spins for
+ *     a while. If a pop takes the value, the push is done.
+ *     Otherwise it takes the value back and tries the stack
+ *     again.
+ *   - A pop spins on a slot waiting for a parked value. If
+ *     it takes one, the pop is done. Otherwise it tries the
+ *     stack again.
+ *
+ * A slot is a single 64-bit word holding a state and the
+ * value, so parking and taking are each one CAS. A parked
+ * slot stays owned by its push until the push empties it
+ * again, so no other push can reuse it in between.
+ *
+ * Each thread adapts how it uses the array:
+ *
+ *   - range, the number of slots it picks from, doubles when
+ *     the slot it picked is busy and halves when it waits in
+ *     a slot without meeting anyone. Few threads meet more
+ *     often in a few slots; many threads need more slots to
+ *     avoid fighting over them.
+ *   - spin, how long it waits in a slot, doubles after a wait
+ *     that found no partner and halves after its CAS on the
+ *     stack works the first time, which means low contention.
+ *
+ * main() runs a small demo and then compares throughput with
+ * the plain Treiber stack from 1 to 64 threads, each doing
+ * a random mix of pushes and pops.
+ *
+ */
+
+// Reuse the lock-free stack, without its demo.
+#define main lock_free_stack_main
+#include "lock-free-stack-using-linked-list.c"
+#undef main
+
+#define ELIMINATION_SLOTS 32
+#define MIN_SPIN 16
+#define MAX_SPIN 4096
+
+#define SLOT_EMPTY 0u
+#define SLOT_PARKED 1u // A push waits with its value.
+#define SLOT_TAKEN 2u // A pop took the parked value.
+
+typedef struct elimination_slot {
+    // State in the high 32 bits, value in the low 32 bits.
+    uint64_t word __attribute__((aligned(CACHE_LINE_SIZE)));
+} elimination_slot;
+
+typedef struct elimination_stack {
+    stack* stack;
+    elimination_slot slots[ELIMINATION_SLOTS];
+} elimination_stack;
+
+typedef struct backoff {
+    int range; // Number of slots to pick from.
+    int spin; // Iterations to wait in a slot.
+    uint32_t random; // xorshift state.
+} backoff;
+
+// Each thread adapts to the contention it sees.
+static _Thread_local backoff thread_backoff = {1, MIN_SPIN, 0};
+
+// Elimination Stack Implementation
+int eliminationPush(elimination_stack*, int);
+int eliminationPop(elimination_stack*);
+int eliminationTryPop(elimination_stack*, int*);
+
+// Elimination Helper Function(s)
+elimination_stack* createEliminationStack(void);
+void freeEliminationStack(elimination_stack*);
+int tryPushOnce(stack*, node*, int*);
+int tryPopOnce(stack*, node**, int*);
+int exchangePush(elimination_stack*, int);
+int exchangePop(elimination_stack*, int*);
+elimination_slot* pickSlot(elimination_stack*);
+uint64_t slotWord(uint32_t, int);
+uint32_t slotState(uint64_t);
+int slotValue(uint64_t);
+
+// Elimination Benchmark
+void* runEliminationMix(void*);
+void* runTreiberMix(void*);
+
+int main() {
+    elimination_stack* my_stack = createEliminationStack();
+
+    printf("Pop: %d\n", eliminationPop(my_stack));
+
+    printf("Push: %d\n", eliminationPush(my_stack, 99));
+    printf("Push: %d\n", eliminationPush(my_stack, 88));
+    printf("Push: %d\n", eliminationPush(my_stack, 77));
+
+    printf("Pop: %d\n", eliminationPop(my_stack));
+    printf("Push: %d\n", eliminationPush(my_stack, 66));
+
+    while (!isEmpty(my_stack->stack))
+        printf("Pop: %d\n", eliminationPop(my_stack));
+
+    freeEliminationStack(my_stack);
+    my_stack = NULL;
+
+    printf("\n%-8s %18s %18s\n", "threads", "elimination ops/s", "treiber ops/s");
+
+    for (int threads = 1; threads <= 64; threads *= 2) {
+        elimination_stack* elimination = createEliminationStack();
+        stack* treiber = createStack();
+
+        double elimination_rate = benchmark(runEliminationMix, elimination, threads);
+        double treiber_rate = benchmark(runTreiberMix, treiber, threads);
+
+        printf("%-8d %18.0f %18.0f\n", threads, elimination_rate, treiber_rate);
+
+        freeEliminationStack(elimination);
+        freeStack(treiber);
+    }
+
+    return 0;
+}
+
+/*
+ *
+ * Elimination Stack Implementation
+ *
+ */
+
+/// Adds a value to the stack, or hands it straight
+/// to a concurrent pop.
+/// \param stack
+/// \param value
+/// \return value added to stack
+int eliminationPush(elimination_stack* stack, int value) {
+    node* new_node = popNode(&stack->stack->free_nodes);
+    if (new_node == NULL)
+        new_node = calloc(1, sizeof(node));
+
+    __atomic_store_n(&new_node->data, value, __ATOMIC_RELAXED);
+
+    int first_try = 1;
+
+    while (1) {
+        if (tryPushOnce(stack->stack, new_node, &first_try))
+            return value;
+
+        if (exchangePush(stack, value)) {
+            // The value went to a pop, the node is unused.
+            pushNode(&stack->stack->free_nodes, new_node);
+            return value;
+        }
+    }
+}
+
+/// Returns and removes last value added to stack.
+/// \param stack
+/// \return last added value if not empty,
+/// otherwise DEFAULT_EMPTY_VALUE
+int eliminationPop(elimination_stack* stack) {
+    int value = DEFAULT_EMPTY_VALUE;
+
+    if (!eliminationTryPop(stack, &value))
+        printf("Pop error! Stack is empty.\n");
+
+    return value;
+}
+
+/// Removes the last value added to stack, or takes
+/// one from a concurrent push.
+/// \param stack
+/// \param value receives the value
+/// \return 1 if a value was popped, otherwise 0
+int eliminationTryPop(elimination_stack* stack, int* value) {
+    int first_try = 1;
+    node* old_top;
+
+    while (1) {
+        if (tryPopOnce(stack->stack, &old_top, &first_try)) {
+            if (old_top == NULL)
+                return 0;
+
+            *value = old_top->data;
+            pushNode(&stack->stack->free_nodes, old_top);
+            return 1;
+        }
+
+        if (exchangePop(stack, value))
+            return 1;
+    }
+}
+
+/*
+ * Elimination Helper Function(s)
+ *
+ */
+
+/// Creates an empty elimination stack.
+/// \return the stack
+elimination_stack* createEliminationStack(void) {
+    elimination_stack* new_stack = aligned_alloc(CACHE_LINE_SIZE, sizeof(elimination_stack));
+    memset(new_stack, 0, sizeof(elimination_stack));
+    new_stack->stack = createStack();
+    return new_stack;
+}
+
+/// Frees the stack and all of its nodes. No
+/// other thread may be using the stack.
+/// \param stack
+void freeEliminationStack(elimination_stack* stack) {
+    freeStack(stack->stack);
+    free(stack);
+}
+
+/// Tries a single CAS to push new_node. Halves
+/// the spin when the very first CAS works.
+/// \param stack
+/// \param new_node
+/// \param first_try 1 before the first attempt, set to 0
+/// \return 1 if pushed, otherwise 0
+int tryPushOnce(stack* stack, node* new_node, int* first_try) {
+    tagged_pointer old_top = loadTaggedPointer(&stack->top);
+    tagged_pointer new_top = {new_node, old_top.tag + 1};
+
+    __atomic_store_n(&new_node->next, old_top.pointer, __ATOMIC_RELAXED);
+
+    int pushed = compareAndSwap(&stack->top, old_top, new_top);
+
+    if (pushed && *first_try && thread_backoff.spin > MIN_SPIN)
+        thread_backoff.spin /= 2;
+    *first_try = 0;
+
+    return pushed;
+}
+
+/// Tries a single CAS to pop the top node.
+/// \param stack
+/// \param old_top receives the node, or NULL if empty
+/// \param first_try 1 before the first attempt, set to 0
+/// \return 1 if done (popped or empty), otherwise 0
+int tryPopOnce(stack* stack, node** old_top, int* first_try) {
+    tagged_pointer top = loadTaggedPointer(&stack->top);
+
+    if (top.pointer == NULL) {
+        *old_top = NULL;
+        return 1;
+    }
+
+    tagged_pointer new_top;
+    new_top.pointer = __atomic_load_n(&top.pointer->next, __ATOMIC_RELAXED);
+    new_top.tag = top.tag + 1;
+
+    int popped = compareAndSwap(&stack->top, top, new_top);
+
+    if (popped && *first_try && thread_backoff.spin > MIN_SPIN)
+        thread_backoff.spin /= 2;
+    *first_try = 0;
+
+    *old_top = top.pointer;
+
+    return popped;
+}
+
+/// Parks value in a slot and waits for a pop
+/// to take it.
+/// \param stack
+/// \param value
+/// \return 1 if a pop took the value, otherwise 0
+int exchangePush(elimination_stack* stack, int value) {
+    elimination_slot* slot = pickSlot(stack);
+    uint64_t empty = slotWord(SLOT_EMPTY, 0);
+    uint64_t parked = slotWord(SLOT_PARKED, value);
+
+    if (!__atomic_compare_exchange_n(&slot->word, &empty, parked, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        // Someone else is using the slot. Spread out.
+        if (thread_backoff.range < ELIMINATION_SLOTS)
+            thread_backoff.range *= 2;
+        return 0;
+    }
+
+    for (int i = 0; i < thread_backoff.spin; i++) {
+        if (slotState(__atomic_load_n(&slot->word, __ATOMIC_ACQUIRE)) == SLOT_TAKEN) {
+            __atomic_store_n(&slot->word, slotWord(SLOT_EMPTY, 0), __ATOMIC_RELEASE);
+            return 1;
+        }
+    }
+
+    // Nobody came. Take the value back, unless a
+    // pop takes it at the last moment.
+    uint64_t expected = parked;
+    if (!__atomic_compare_exchange_n(&slot->word, &expected, slotWord(SLOT_EMPTY, 0),
+                                     0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(&slot->word, slotWord(SLOT_EMPTY, 0), __ATOMIC_RELEASE);
+        return 1;
+    }
+
+    if (thread_backoff.range > 1)
+        thread_backoff.range /= 2;
+    if (thread_backoff.spin < MAX_SPIN)
+        thread_backoff.spin *= 2;
+
+    return 0;
+}
+
+/// Waits in a slot for a parked push and takes
+/// its value.
+/// \param stack
+/// \param value receives the value
+/// \return 1 if a value was taken, otherwise 0
+int exchangePop(elimination_stack* stack, int* value) {
+    elimination_slot* slot = pickSlot(stack);
+
+    for (int i = 0; i < thread_backoff.spin; i++) {
+        uint64_t word = __atomic_load_n(&slot->word, __ATOMIC_ACQUIRE);
+
+        if (slotState(word) != SLOT_PARKED)
+            continue;
+
+        if (__atomic_compare_exchange_n(&slot->word, &word, slotWord(SLOT_TAKEN, 0),
+                                        0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            *value = slotValue(word);
+            return 1;
+        }
+
+        // Another pop took it first. Spread out.
+        if (thread_backoff.range < ELIMINATION_SLOTS)
+            thread_backoff.range *= 2;
+        return 0;
+    }
+
+    if (thread_backoff.range > 1)
+        thread_backoff.range /= 2;
+    if (thread_backoff.spin < MAX_SPIN)
+        thread_backoff.spin *= 2;
+
+    return 0;
+}
+
+/// Picks a random slot within the thread's range.
+/// \param stack
+/// \return the slot
+elimination_slot* pickSlot(elimination_stack* stack) {
+    uint32_t x = thread_backoff.random;
+
+    // Seed from the address of the thread local,
+    // which differs between threads.
+    if (x == 0)
+        x = (uint32_t) (uintptr_t) &thread_backoff | 1;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    thread_backoff.random = x;
+
+    return &stack->slots[x % thread_backoff.range];
+}
+
+/// Packs a slot state and value into one word.
+uint64_t slotWord(uint32_t state, int value) {
+    return ((uint64_t) state << 32) | (uint32_t) value;
+}
+
+/// Unpacks the state of a slot word.
+uint32_t slotState(uint64_t word) {
+    return (uint32_t) (word >> 32);
+}
+
+/// Unpacks the value of a slot word.
+int slotValue(uint64_t word) {
+    return (int) (uint32_t) word;
+}
+
+/*
+ * Elimination Benchmark
+ *
+ */
+
+/// Pushes or pops at random, half and half, until
+/// args->ops operations are done.
+/// \param arg benchmark_args
+/// \return NULL
+void* runEliminationMix(void* arg) {
+    benchmark_args* args = arg;
+    elimination_stack* shared = args->shared;
+    uint32_t random = (uint32_t) (uintptr_t) &random | 1;
+    int value;
+
+    for (int i = 0; i < args->ops; i++) {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+
+        if (random & 1)
+            eliminationPush(shared, i);
+        else
+            eliminationTryPop(shared, &value);
+    }
+
+    return NULL;
+}
+
+/// Same as runEliminationMix on the plain Treiber stack.
+/// \param arg benchmark_args
+/// \return NULL
+void* runTreiberMix(void* arg) {
+    benchmark_args* args = arg;
+    stack* shared = args->shared;
+    uint32_t random = (uint32_t) (uintptr_t) &random | 1;
+    int value;
+
+    for (int i = 0; i < args->ops; i++) {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+
+        if (random & 1)
+            push(shared, i);
+        else
+            tryPop(shared, &value);
+    }
+
+    return NULL;
+}
@@ -0,0 +1,469 @@
+/*
+ *
+ * Lock-Free Stack Data Structure (Treiber Stack)
+ *
+ *    Uses:
+ *      Linked List, Tagged Pointers,
+ *      Double-Width Compare-And-Swap
+ *
+ *    Sample Operations:
+ *      push, peek, pop, tryPop, isEmpty
+ *
+ *    Build:
+ *      gcc -O2 -mcx16 -pthread lock-free-stack-using-linked-list.c
+ *
+ *    Instrumentation (-DINSTRUMENT):
+ *      lock_free_stack.cas_attempts, one value
+ *      per push or pop of a node, counted across
+ *      all threads, lock_free_stack.nodes
+ *
+ * Notes:
+ *
+ * This is stack-using-linked-list.c made safe to share
+ * between threads without a lock. Push and pop read the
+ * top of the stack, build the new top, and swap it in with
+ * a single compare-and-swap (CAS). If another thread changed
+ * the top in the meantime the CAS fails and they try again.
+ *
+ * The ABA problem: thread 1 reads top = A and A->next = B,
+ * then sleeps. Thread 2 pops A, pops B, and pushes A back.
+ * The top is A again, so thread 1's CAS from A to B succeeds
+ * even though B is no longer on the stack. To stop that, the
+ * top is a tagged pointer: the node pointer plus a counter
+ * that goes up on every change. Both are swapped together
+ * with a 16-byte CAS (cmpxchg16b on x86-64, hence -mcx16),
+ * so an old copy of the top never matches again.
+ *
+ * Memory reclamation: a popping thread may still read
+ * A->next after another thread has popped A. If A had been
+ * freed, that read could fault. Popped nodes are therefore
+ * never freed while the stack is in use. They go on a free
+ * list, which is a second Treiber stack, and push takes its
+ * nodes from there before calling calloc. A stale read gets
+ * a valid, if meaningless, next pointer, and the tag makes
+ * the CAS fail. freeStack releases all nodes once no thread
+ * uses the stack anymore. Once the free list has warmed up,
+ * push and pop do not allocate at all.
+ *
+ * main() runs a small demo and then a contention benchmark
+ * against stack-using-linked-list.c wrapped in a mutex.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../instrumentation/instrumentation.h"
+
+#ifndef __SIZEOF_INT128__
+#error "A 16-byte compare-and-swap is required."
+#endif
+
+#define DEFAULT_EMPTY_VALUE (-1)
+#define CACHE_LINE_SIZE 64
+
+typedef struct node {
+    int data;
+    struct node* next;
+} node;
+
+typedef struct tagged_pointer {
+    node* pointer;
+    uintptr_t tag; // Bumped on every change of pointer.
+} __attribute__((aligned(16))) tagged_pointer;
+
+typedef struct stack {
+    // Each list on its own cache line so pushes and
+    // pops do not slow down free list operations.
+    tagged_pointer top __attribute__((aligned(CACHE_LINE_SIZE)));
+    tagged_pointer free_nodes __attribute__((aligned(CACHE_LINE_SIZE)));
+} stack;
+
+// Mutex-wrapped stack-using-linked-list.c,
+// used as the baseline in the benchmark.
+typedef struct locked_stack {
+    pthread_mutex_t lock;
+    node* top;
+} locked_stack;
+
+int push(stack* stack, int value);
+int peek(stack* stack);
+int pop(stack* stack);
+int tryPop(stack* stack, int* value);
+int isEmpty(stack* stack);
+
+// Helper Function(s)
+stack* createStack(void);
+void freeStack(stack* stack);
+void pushNode(tagged_pointer* list, node* new_node);
+node* popNode(tagged_pointer* list);
+tagged_pointer loadTaggedPointer(tagged_pointer* list);
+int compareAndSwap(tagged_pointer* list, tagged_pointer expected, tagged_pointer desired);
+
+// Benchmark
+int lockedPush(locked_stack* stack, int value);
+int lockedTryPop(locked_stack* stack, int* value);
+void* runLockFree(void* arg);
+void* runLocked(void* arg);
+double benchmark(void* (*worker)(void*), void* shared, int threads);
+
+int main() {
+    stack* my_stack = createStack();
+
+    // Stack is empty and should display 1.
+    printf("isEmpty = %d\n", isEmpty(my_stack));
+
+    // Peek and pop on empty stack displays
+    // an error and DEFAULT_EMPTY_VALUE.
+    printf("Peek: %d\n", peek(my_stack));
+    printf("Pop: %d\n", pop(my_stack));
+
+    printf("Push: %d\n", push(my_stack, 99));
+    printf("Push: %d\n", push(my_stack, 88));
+    printf("Push: %d\n", push(my_stack, 77));
+
+    printf("Pop: %d\n", pop(my_stack));
+    printf("Push: %d\n", push(my_stack, 66));
+
+    while (!isEmpty(my_stack)) {
+        printf("Peek: %d\n", peek(my_stack));
+        printf("Pop: %d\n", pop(my_stack));
+    }
+
+    freeStack(my_stack);
+    my_stack = NULL;
+
+    // Every thread pushes and pops in a loop, the way
+    // threads share a pool of free objects.
+    printf("\n%-8s %16s %16s\n", "threads", "lock-free ops/s", "mutex ops/s");
+
+    for (int threads = 1; threads <= 16; threads *= 2) {
+        stack* lock_free = createStack();
+        locked_stack locked = {PTHREAD_MUTEX_INITIALIZER, NULL};
+
+        double lock_free_rate = benchmark(runLockFree, lock_free, threads);
+        double locked_rate = benchmark(runLocked, &locked, threads);
+
+        printf("%-8d %16.0f %16.0f\n", threads, lock_free_rate, locked_rate);
+
+        freeStack(lock_free);
+
+        int value;
+        while (lockedTryPop(&locked, &value))
+            ;
+        pthread_mutex_destroy(&locked.lock);
+    }
+
+    INSTRUMENT_DUMP(stdout);
+
+    return 0;
+}
+
+/*
+ *
+ * Stack Implementation
+ *
+ */
+
+/// Adds a value to the stack. Reuses a node
+/// from the free list when there is one.
+/// \param stack
+/// \param value
+/// \return value added to stack
+int push(stack* stack, int value) {
+    node* new_node = popNode(&stack->free_nodes);
+
+    if (new_node == NULL) {
+        new_node = calloc(1, sizeof(node));
+        INSTRUMENT_COUNT(lock_free_stack, nodes, 1);
+    }
+
+    // Atomic only because peek may read a node
+    // that has been popped and reused.
+    __atomic_store_n(&new_node->data, value, __ATOMIC_RELAXED);
+    pushNode(&stack->top, new_node);
+
+    return value;
+}
+
+/// Returns last value added to the stack. With other
+/// threads running the value may already be popped.
+/// \param stack
+/// \return last added value if not empty,
+/// otherwise DEFAULT_EMPTY_VALUE
+int peek(stack* stack) {
+    node* top = __atomic_load_n(&stack->top.pointer, __ATOMIC_ACQUIRE);
+
+    if (top == NULL) {
+        printf("Peek error! Stack is empty.\n");
+        return DEFAULT_EMPTY_VALUE;
+    }
+
+    // The node may be popped and reused meanwhile,
+    // but it is never freed, so this read is safe.
+    return __atomic_load_n(&top->data, __ATOMIC_RELAXED);
+}
+
+/// Returns and removes last value added to stack.
+/// \param stack
+/// \return last added value if not empty,
+/// otherwise DEFAULT_EMPTY_VALUE
+int pop(stack* stack) {
+    int value = DEFAULT_EMPTY_VALUE;
+
+    if (!tryPop(stack, &value))
+        printf("Pop error! Stack is empty.\n");
+
+    return value;
+}
+
+/// Removes the last value added to stack without
+/// printing an error when it is empty, for threads
+/// that expect to find it empty now and then.
+/// \param stack
+/// \param value receives the value
+/// \return 1 if a value was popped, otherwise 0
+int tryPop(stack* stack, int* value) {
+    node* old_top = popNode(&stack->top);
+
+    if (old_top == NULL)
+        return 0;
+
+    // This thread owns the node now.
+    *value = old_top->data;
+    pushNode(&stack->free_nodes, old_top);
+
+    return 1;
+}
+
+/// Determines if the stack is empty.
+/// \param stack
+/// \return 1 if empty, otherwise 0
+int isEmpty(stack* stack) {
+    return __atomic_load_n(&stack->top.pointer, __ATOMIC_ACQUIRE) == NULL;
+}
+
+/*
+ * Helper Function(s)
+ *
+ */
+
+/// Creates an empty stack.
+/// \return the stack
+stack* createStack(void) {
+    stack* new_stack = aligned_alloc(CACHE_LINE_SIZE, sizeof(stack));
+    memset(new_stack, 0, sizeof(stack));
+    return new_stack;
+}
+
+/// Frees the stack and all of its nodes. No
+/// other thread may be using the stack.
+/// \param stack
+void freeStack(stack* stack) {
+    tagged_pointer* lists[] = {&stack->top, &stack->free_nodes};
+
+    for (int i = 0; i < 2; i++) {
+        node* current_node = lists[i]->pointer;
+
+        while (current_node != NULL) {
+            node* next_node = current_node->next;
+            free(current_node);
+            current_node = next_node;
+        }
+    }
+
+    free(stack);
+}
+
+/// Pushes a node the calling thread owns.
+/// \param list top of a Treiber stack
+/// \param new_node
+void pushNode(tagged_pointer* list, node* new_node) {
+    tagged_pointer old_top;
+    tagged_pointer new_top;
+    int attempts = 0;
+
+    do {
+        attempts++;
+        old_top = loadTaggedPointer(list);
+        __atomic_store_n(&new_node->next, old_top.pointer, __ATOMIC_RELAXED);
+        new_top.pointer = new_node;
+        new_top.tag = old_top.tag + 1;
+    } while (!compareAndSwap(list, old_top, new_top));
+
+    INSTRUMENT_RECORD(lock_free_stack, cas_attempts, attempts);
+}
+
+/// Pops a node and hands it to the calling thread.
+/// \param list top of a Treiber stack
+/// \return the node, or NULL if the list is empty
+node* popNode(tagged_pointer* list) {
+    tagged_pointer old_top;
+    tagged_pointer new_top;
+    int attempts = 0;
+
+    do {
+        attempts++;
+        old_top = loadTaggedPointer(list);
+        if (old_top.pointer == NULL)
+            return NULL;
+
+        // old_top.pointer may already be popped by another
+        // thread. Its next is then stale, but the tag will
+        // not match and the CAS fails.
+        new_top.pointer = __atomic_load_n(&old_top.pointer->next, __ATOMIC_RELAXED);
+        new_top.tag = old_top.tag + 1;
+    } while (!compareAndSwap(list, old_top, new_top));
+
+    INSTRUMENT_RECORD(lock_free_stack, cas_attempts, attempts);
+
+    return old_top.pointer;
+}
+
+/// Reads a tagged pointer. The two halves are read
+/// separately and may not match each other, in which
+/// case the CAS that uses them fails and retries.
+/// \param list
+/// \return the tagged pointer
+tagged_pointer loadTaggedPointer(tagged_pointer* list) {
+    tagged_pointer value;
+    value.tag = __atomic_load_n(&list->tag, __ATOMIC_ACQUIRE);
+    value.pointer = __atomic_load_n(&list->pointer, __ATOMIC_ACQUIRE);
+    return value;
+}
+
+/// Swaps pointer and tag together if both still
+/// equal expected.
+/// \param list
+/// \param expected
+/// \param desired
+/// \return 1 if swapped, otherwise 0
+int compareAndSwap(tagged_pointer* list, tagged_pointer expected, tagged_pointer desired) {
+    unsigned __int128 expected_bits;
+    unsigned __int128 desired_bits;
+
+    memcpy(&expected_bits, &expected, sizeof(expected_bits));
+    memcpy(&desired_bits, &desired, sizeof(desired_bits));
+
+    return __sync_bool_compare_and_swap((unsigned __int128*) list,
+                                        expected_bits, desired_bits);
+}
+
+/*
+ * Benchmark
+ *
+ */
+
+#define BENCHMARK_OPS 1000000
+#define BENCHMARK_DEPTH 4
+
+typedef struct benchmark_args {
+    void* shared;
+    int ops;
+} benchmark_args;
+
+/// Pushes a value onto the locked stack,
+/// allocating a node as the original does.
+/// \param stack
+/// \param value
+/// \return value added to stack
+int lockedPush(locked_stack* stack, int value) {
+    node* new_node = calloc(1, sizeof(node));
+    new_node->data = value;
+
+    pthread_mutex_lock(&stack->lock);
+    new_node->next = stack->top;
+    stack->top = new_node;
+    pthread_mutex_unlock(&stack->lock);
+
+    return value;
+}
+
+/// Pops a value from the locked stack.
+/// \param stack
+/// \param value receives the value
+/// \return 1 if a value was popped, otherwise 0
+int lockedTryPop(locked_stack* stack, int* value) {
+    pthread_mutex_lock(&stack->lock);
+    node* old_top = stack->top;
+    if (old_top != NULL)
+        stack->top = old_top->next;
+    pthread_mutex_unlock(&stack->lock);
+
+    if (old_top == NULL)
+        return 0;
+
+    *value = old_top->data;
+    free(old_top);
+
+    return 1;
+}
+
+/// Pushes BENCHMARK_DEPTH values, then pops as many,
+/// until ops operations are done on the lock-free stack.
+/// \param arg benchmark_args
+/// \return NULL
+void* runLockFree(void* arg) {
+    benchmark_args* args = arg;
+    stack* shared = args->shared;
+    int value;
+
+    for (int i = 0; i < args->ops; i += 2 * BENCHMARK_DEPTH) {
+        for (int j = 0; j < BENCHMARK_DEPTH; j++)
+            push(shared, i + j);
+        for (int j = 0; j < BENCHMARK_DEPTH; j++)
+            tryPop(shared, &value);
+    }
+
+    return NULL;
+}
+
+/// Same as runLockFree on the mutex-wrapped stack.
+/// \param arg benchmark_args
+/// \return NULL
+void* runLocked(void* arg) {
+    benchmark_args* args = arg;
+    locked_stack* shared = args->shared;
+    int value;
+
+    for (int i = 0; i < args->ops; i += 2 * BENCHMARK_DEPTH) {
+        for (int j = 0; j < BENCHMARK_DEPTH; j++)
+            lockedPush(shared, i + j);
+        for (int j = 0; j < BENCHMARK_DEPTH; j++)
+            lockedTryPop(shared, &value);
+    }
+
+    return NULL;
+}
+
+/// Runs worker on threads threads that all share
+/// one stack, splitting BENCHMARK_OPS between them.
+/// \param worker
+/// \param shared the stack
+/// \param threads
+/// \return operations per second
+double benchmark(void* (*worker)(void*), void* shared, int threads) {
+    pthread_t* ids = calloc(threads, sizeof(pthread_t));
+    benchmark_args args = {shared, BENCHMARK_OPS / threads};
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int i = 0; i < threads; i++)
+        pthread_create(&ids[i], NULL, worker, &args);
+    for (int i = 0; i < threads; i++)
+        pthread_join(ids[i], NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    free(ids);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    return (double) args.ops * threads / seconds;
+}
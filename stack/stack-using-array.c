@@ -3,65 +3,126 @@
  * Stack Data Structure
  *
  *    Uses:
- *      Array
+ *      Growable Array
  *
  *    Sample Operations:
- *      push, peek, pop, isEmpty, isFull
+ *      push, peek, pop, isEmpty, reserve, shrinkToFit
+ *
+ *    Instrumentation (-DINSTRUMENT):
+ *      stack_array.push, stack_array.pop,
+ *      stack_array.resize_values,
+ *      stack_array.depth (high water)
+ *
+ * Notes:
+ *
+ * The stack starts out using a small array inside the
+ * stack struct itself, so a stack that never holds more
+ * than INLINE_SIZE values never calls malloc.
+ *
+ * When the array is full, push moves the values to a heap
+ * array twice as large. Doubling keeps the cost of copying
+ * to O(1) per push on average, however deep the stack gets.
+ *
+ * Pop gives memory back by halving the array, but only once
+ * the stack is down to a quarter of it. Halving at half full
+ * would leave the array full again, and a push followed by a
+ * pop right at that size would grow and shrink the array on
+ * every call. Waiting for a quarter leaves the halved array
+ * half full, with room to move either way. The array never
+ * shrinks below INLINE_SIZE. Once the values fit, they move
+ * back into the inline array and the heap array is freed.
+ *
+ * Because array can point into the stack struct itself,
+ * a stack must not be copied by value. Pass it by pointer.
+ *
+ * initStackOnPages makes a stack whose heap array is mapped
+ * by the page allocator instead of malloc: on huge pages,
+ * bound to a NUMA node and faulted in as soon as it grows,
+ * as the options say. The array then uses all of the pages
+ * mapped, so a stack on 2 MB pages grows straight to 512K
+ * values. Pop never shrinks it, as giving pages back and
+ * faulting them in again is what it is there to avoid.
+ * shrinkToFit still does.
  *
  */
 
+#define _GNU_SOURCE
+
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../allocator/page-allocator.h"
+#include "../instrumentation/instrumentation.h"
 
 #define DEFAULT_VALUE (-1)
-#define MAX_SIZE 10
+#define INLINE_SIZE 16
 
 typedef struct {
-    int array[MAX_SIZE];
+    int* array; // Either inline_array or a heap array.
     int top;
-    int size;
+    int capacity;
+    const page_options* pages; // NULL to use malloc.
+    size_t mapped_size; // Bytes mapped for array, 0 if none.
+    int inline_array[INLINE_SIZE];
 } stack;
 
 int push(stack*, int);
 int peek(stack*);
 int pop(stack*);
 int isEmpty(stack*);
-int isFull(stack*);
+int reserve(stack*, int);
+void shrinkToFit(stack*);
+
+// Helper Function(s)
+void initStack(stack*);
+void initStackOnPages(stack*, const page_options*);
+void freeStack(stack*);
+int resize(stack*, int);
+void freeArray(stack*);
 
 int main() {
-    // Not using dynamic memory allocation
-    // (calloc or malloc) for this example.
+    // The stack struct itself is not
+    // allocated with calloc or malloc.
     stack my_stack;
-    my_stack.top = -1;
-    my_stack.size = MAX_SIZE;
+    initStack(&my_stack);
 
     // Stack is empty and should display 1.
     printf("isEmpty = %d\n", isEmpty(&my_stack));
 
-    // Stack is not full and should display 0.
-    printf("isFull = %d\n", isFull(&my_stack));
-
     // Peek and pop on empty stack displays
-    // an error and DEFAULT_EMPTY_VALUE.
+    // an error and DEFAULT_VALUE.
     printf("Peek: %d\n", peek(&my_stack));
     printf("Pop: %d\n", pop(&my_stack));
 
-    // Push values on stack until it's full.
+    // A few values fit in the inline array.
     int value = 200;
 
-    while (!isFull(&my_stack)) {
+    for (int i = 0; i < 5; i++) {
         printf("Push: %d\n", push(&my_stack, value));
         value -= 10;
     }
 
-    // Stack is not empty and should display 0.
-    printf("isEmpty = %d\n", isEmpty(&my_stack));
+    printf("Capacity = %d\n", my_stack.capacity);
+
+    // Push far more than the inline array holds.
+    for (int i = 0; i < 100000; i++)
+        push(&my_stack, i);
 
-    // Stack is full and should display 1.
-    printf("isFull = %d\n", isFull(&my_stack));
+    printf("Capacity after 100000 pushes = %d\n", my_stack.capacity);
 
-    // Push on full stack displays
-    // an error and DEFAULT_EMPTY_VALUE.
-    printf("Push: %d\n", push(&my_stack, value-10));
+    // Popping most of them shrinks the array.
+    for (int i = 0; i < 99990; i++)
+        pop(&my_stack);
+
+    printf("Capacity after 99990 pops = %d\n", my_stack.capacity);
+
+    shrinkToFit(&my_stack);
+    printf("Capacity after shrinkToFit = %d\n", my_stack.capacity);
+
+    reserve(&my_stack, 1000);
+    printf("Capacity after reserve(1000) = %d\n", my_stack.capacity);
 
     // Loop through the stack and display
     // all remaining values until empty.
@@ -73,8 +134,27 @@ int main() {
     // Stack is empty and should display 1.
     printf("isEmpty = %d\n", isEmpty(&my_stack));
 
-    // Stack is not full and should display 0.
-    printf("isFull = %d\n", isFull(&my_stack));
+    freeStack(&my_stack);
+
+    // The same pushes on transparent huge pages,
+    // on this thread's NUMA node, faulted in as
+    // the array grows.
+    page_options options = {PAGES_TRANSPARENT_HUGE, PAGE_NODE_LOCAL, 1};
+    initStackOnPages(&my_stack, &options);
+
+    for (int i = 0; i < 100000; i++)
+        push(&my_stack, i);
+
+    printf("Capacity on huge pages after 100000 pushes = %d\n", my_stack.capacity);
+
+    for (int i = 0; i < 99990; i++)
+        pop(&my_stack);
+
+    printf("Capacity on huge pages after 99990 pops = %d\n", my_stack.capacity);
+
+    freeStack(&my_stack);
+
+    INSTRUMENT_DUMP(stdout);
 
     return 0;
 }
@@ -85,28 +165,34 @@ int main() {
  *
  */
 
-/// Adds a value to the stack.
+/// Adds a value to the stack, doubling the
+/// array first if it is full.
 /// \param stack
 /// \param value
-/// \return value added to stack
+/// \return value added to stack, or DEFAULT_VALUE
+/// if the array could not grow
 int push(stack* stack, int value) {
-    int return_value = value;
-
-    if (isFull(stack)) {
-        printf("Push error! Stack is full.\n");
-        return_value = DEFAULT_VALUE;
-    } else {
-        stack->top++;
-        stack->array[stack->top] = value;
+    if (stack->top == stack->capacity - 1) {
+        if (stack->capacity > INT_MAX / 2
+            || !resize(stack, stack->capacity * 2)) {
+            printf("Push error! Out of memory.\n");
+            return DEFAULT_VALUE;
+        }
     }
 
-    return return_value;
+    stack->top++;
+    stack->array[stack->top] = value;
+
+    INSTRUMENT_COUNT(stack_array, push, 1);
+    INSTRUMENT_HIGH_WATER(stack_array, depth, stack->top + 1);
+
+    return value;
 }
 
 /// Returns last value added to the stack.
 /// \param stack
 /// \return last added value if not empty,
-/// otherwise DEFAULT_EMPTY_VALUE
+/// otherwise DEFAULT_VALUE
 int peek(stack* stack) {
     int return_value = DEFAULT_VALUE;
 
@@ -120,9 +206,10 @@ int peek(stack* stack) {
 }
 
 /// Returns and removes last value added to stack.
+/// Halves the array once it is a quarter full.
 /// \param stack
 /// \return last added value if not empty,
-/// otherwise DEFAULT_EMPTY_VALUE
+/// otherwise DEFAULT_VALUE
 int pop(stack* stack) {
     int return_value = DEFAULT_VALUE;
 
@@ -131,6 +218,11 @@ int pop(stack* stack) {
     } else {
         return_value = stack->array[stack->top];
         stack->top--;
+        INSTRUMENT_COUNT(stack_array, pop, 1);
+
+        int size = stack->top + 1;
+        if (stack->pages == NULL && stack->capacity > INLINE_SIZE && size <= stack->capacity / 4)
+            resize(stack, stack->capacity / 2);
     }
 
     return return_value;
@@ -143,9 +235,134 @@ int isEmpty(stack* stack) {
     return stack->top == -1;
 }
 
-/// Determines if the stack is full.
+/// Makes room for at least capacity values, so
+/// pushing up to that many does not reallocate.
+/// \param stack
+/// \param capacity
+/// \return 1 if the room is there, otherwise 0
+int reserve(stack* stack, int capacity) {
+    if (capacity <= stack->capacity)
+        return 1;
+
+    return resize(stack, capacity);
+}
+
+/// Shrinks the array to the number of values in
+/// the stack, or back to the inline array if they
+/// fit in it.
 /// \param stack
-/// \return 1 if full, otherwise 0
-int isFull(stack* stack) {
-    return stack->top == stack->size - 1;
+void shrinkToFit(stack* stack) {
+    resize(stack, stack->top + 1);
+}
+
+/*
+ * Helper Function(s)
+ *
+ */
+
+/// Initializes an empty stack that uses
+/// the inline array.
+/// \param stack
+void initStack(stack* stack) {
+    stack->array = stack->inline_array;
+    stack->top = -1;
+    stack->capacity = INLINE_SIZE;
+    stack->pages = NULL;
+    stack->mapped_size = 0;
+}
+
+/// Initializes an empty stack that uses the
+/// inline array, and maps its heap array with
+/// the page allocator once it outgrows it.
+/// \param stack
+/// \param options kept by the stack, so they
+/// must outlive it
+void initStackOnPages(stack* stack, const page_options* options) {
+    initStack(stack);
+    stack->pages = options;
+}
+
+/// Frees the heap array, if any, and
+/// leaves the stack empty.
+/// \param stack
+void freeStack(stack* stack) {
+    const page_options* pages = stack->pages;
+
+    if (stack->array != stack->inline_array)
+        freeArray(stack);
+
+    initStack(stack);
+    stack->pages = pages;
+}
+
+/// Moves the values to an array of the given
+/// capacity. Capacities up to INLINE_SIZE use
+/// the inline array. The caller makes sure the
+/// values fit.
+/// \param stack
+/// \param capacity
+/// \return 1 on success, otherwise 0 and the
+/// stack is unchanged
+int resize(stack* stack, int capacity) {
+    int size = stack->top + 1;
+    int on_heap = stack->array != stack->inline_array;
+
+    INSTRUMENT_RECORD(stack_array, resize_values, size);
+
+    if (capacity <= INLINE_SIZE) {
+        if (on_heap) {
+            memcpy(stack->inline_array, stack->array, size * sizeof(int));
+            freeArray(stack);
+            stack->array = stack->inline_array;
+        }
+        stack->capacity = INLINE_SIZE;
+        return 1;
+    }
+
+    int* array;
+
+    if (stack->pages != NULL) {
+        size_t bytes = (size_t) capacity * sizeof(int);
+
+        if (on_heap)
+            array = pageResize(stack->array, stack->mapped_size, size * sizeof(int),
+                               &bytes, stack->pages);
+        else
+            array = pageAlloc(&bytes, stack->pages);
+
+        if (array == NULL)
+            return 0;
+        if (!on_heap)
+            memcpy(array, stack->inline_array, size * sizeof(int));
+
+        // Use all of the pages mapped.
+        stack->mapped_size = bytes;
+        capacity = bytes / sizeof(int) > INT_MAX ? INT_MAX : (int) (bytes / sizeof(int));
+    } else if (on_heap) {
+        array = realloc(stack->array, capacity * sizeof(int));
+        if (array == NULL)
+            return 0;
+    } else {
+        array = malloc(capacity * sizeof(int));
+        if (array == NULL)
+            return 0;
+        memcpy(array, stack->inline_array, size * sizeof(int));
+    }
+
+    stack->array = array;
+    stack->capacity = capacity;
+
+    return 1;
+}
+
+/// Frees the heap array, by the allocator
+/// it came from.
+/// \param stack
+void freeArray(stack* stack) {
+    if (stack->mapped_size != 0)
+        pageFree(stack->array, stack->mapped_size);
+    else
+        free(stack->array);
+
+    stack->mapped_size = 0;
 }
@@ -8,11 +8,18 @@
  *    Sample Operations:
  *      push, peek, pop, isEmpty
  *
+ *    Instrumentation (-DINSTRUMENT):
+ *      stack_list.push, stack_list.pop,
+ *      stack_list.empty
+ *
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "../allocator/slab-allocator.h"
+#include "../instrumentation/instrumentation.h"
+
 #define DEFAULT_EMPTY_VALUE (-1)
 
 typedef struct node {
@@ -60,6 +67,8 @@ int main() {
     free(my_stack);
     my_stack = NULL;
 
+    INSTRUMENT_DUMP(stdout);
+
     return 0;
 }
 
@@ -74,11 +83,13 @@ int main() {
 /// \param value
 /// \return value added to stack
 int push(stack* stack, int value) {
-    node* new_node = calloc(1, sizeof(node));
+    node* new_node = slabCalloc(sizeof(node));
     new_node->data = value;
     new_node->next = stack->top;
     stack->top = new_node;
 
+    INSTRUMENT_COUNT(stack_list, push, 1);
+
     return value;
 }
 
@@ -106,13 +117,15 @@ int pop(stack* stack) {
     int value = DEFAULT_EMPTY_VALUE;
 
     if (stack->top == NULL) {
+        INSTRUMENT_COUNT(stack_list, empty, 1);
         printf("Pop error! Stack is empty.\n");
     } else {
+        INSTRUMENT_COUNT(stack_list, pop, 1);
         value = stack->top->data;
 
         node* previous_top = stack->top;
         stack->top = previous_top->next;
-        free(previous_top);
+        slabFree(previous_top, sizeof(node));
     }
 
     return value;
@@ -0,0 +1,278 @@
+/*
+ *
+ * Stack Data Structure
+ *
+ *    Uses:
+ *      Linked List of Arrays (Segments)
+ *
+ *    Sample Operations:
+ *      push, peek, pop, isEmpty, clear
+ *
+ * Notes:
+ *
+ * stack-using-linked-list.c allocates a 16-byte node for
+ * every 4-byte int it pushes, plus the malloc header, and
+ * the nodes end up all over the heap. This stack links
+ * fixed-size arrays of values instead. A segment is 4 KB
+ * and holds about a thousand values, so the memory used is
+ * close to 4 bytes per value and neighbouring values share
+ * cache lines.
+ *
+ * Push only allocates when the top segment is full, and pop
+ * only releases one when it becomes empty. An emptied segment
+ * is kept as a spare rather than freed, so pushing and popping
+ * back and forth across the end of a segment reuses the spare
+ * instead of calling malloc and free every time. Only one
+ * spare is kept this way; further emptied segments are freed.
+ *
+ * clear is O(1) no matter how many values there are. The
+ * stack remembers its bottom segment, so the whole chain can
+ * be moved onto the spare list by changing two pointers. The
+ * next pushes reuse those spares. releaseSpares frees them
+ * when the memory is wanted back.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_EMPTY_VALUE (-1)
+#define SEGMENT_BYTES 4096
+#define SEGMENT_SIZE ((SEGMENT_BYTES - sizeof(struct segment*)) / sizeof(int))
+
+typedef struct segment {
+    struct segment* previous; // Segment below, or next spare.
+    int values[];
+} segment;
+
+typedef struct stack {
+    segment* top; // Segment holding the top value.
+    segment* bottom; // Segment holding the bottom value.
+    int top_index; // Index of the top value in top.
+    long size;
+    segment* spares; // Emptied segments ready for reuse.
+} stack;
+
+int push(stack* stack, int value);
+int peek(stack* stack);
+int pop(stack* stack);
+int isEmpty(stack* stack);
+long clear(stack* stack);
+
+// Helper Function(s)
+stack* createStack(void);
+void freeStack(stack* stack);
+void releaseSpares(stack* stack);
+segment* takeSegment(stack* stack);
+
+int main() {
+    stack* my_stack = createStack();
+
+    // Stack is empty and should display 1.
+    printf("isEmpty = %d\n", isEmpty(my_stack));
+
+    // Peek and pop on empty stack displays
+    // an error and DEFAULT_EMPTY_VALUE.
+    printf("Peek: %d\n", peek(my_stack));
+    printf("Pop: %d\n", pop(my_stack));
+
+    printf("Push: %d\n", push(my_stack, 99));
+    printf("Push: %d\n", push(my_stack, 88));
+    printf("Push: %d\n", push(my_stack, 77));
+
+    printf("Pop: %d\n", pop(my_stack));
+    printf("Push: %d\n", push(my_stack, 66));
+
+    while (!isEmpty(my_stack)) {
+        printf("Peek: %d\n", peek(my_stack));
+        printf("Pop: %d\n", pop(my_stack));
+    }
+
+    printf("\nValues per segment = %zu\n", SEGMENT_SIZE);
+
+    // Fill exactly one segment, then push and pop
+    // across its end. The spare is reused each time.
+    for (size_t i = 0; i < SEGMENT_SIZE; i++)
+        push(my_stack, (int) i);
+    for (int i = 0; i < 1000000; i++) {
+        push(my_stack, i);
+        pop(my_stack);
+    }
+    printf("Size after boundary ping-pong = %ld\n", my_stack->size);
+
+    for (int i = 0; i < 10000000; i++)
+        push(my_stack, i);
+    printf("Size after 10M pushes = %ld\n", my_stack->size);
+
+    printf("Clear. Values removed: %ld\n", clear(my_stack));
+    printf("isEmpty = %d\n", isEmpty(my_stack));
+
+    freeStack(my_stack);
+    my_stack = NULL;
+
+    return 0;
+}
+
+/*
+ *
+ * Stack Implementation
+ *
+ */
+
+/// Adds a value to the stack. Starts a new segment
+/// when the top one is full.
+/// \param stack
+/// \param value
+/// \return value added to stack, or DEFAULT_EMPTY_VALUE
+/// if out of memory
+int push(stack* stack, int value) {
+    if (stack->top == NULL || stack->top_index == (int) SEGMENT_SIZE - 1) {
+        segment* new_segment = takeSegment(stack);
+        if (new_segment == NULL) {
+            printf("Push error! Out of memory.\n");
+            return DEFAULT_EMPTY_VALUE;
+        }
+
+        new_segment->previous = stack->top;
+        stack->top = new_segment;
+        stack->top_index = -1;
+
+        if (stack->bottom == NULL)
+            stack->bottom = new_segment;
+    }
+
+    stack->top_index++;
+    stack->top->values[stack->top_index] = value;
+    stack->size++;
+
+    return value;
+}
+
+/// Returns last value added to the stack.
+/// \param stack
+/// \return last added value if not empty,
+/// otherwise DEFAULT_EMPTY_VALUE
+int peek(stack* stack) {
+    int value = DEFAULT_EMPTY_VALUE;
+
+    if (isEmpty(stack)) {
+        printf("Peek error! Stack is empty.\n");
+    } else {
+        value = stack->top->values[stack->top_index];
+    }
+
+    return value;
+}
+
+/// Returns and removes last value added to stack.
+/// An emptied segment becomes the spare, or is
+/// freed if there already is one.
+/// \param stack
+/// \return last added value if not empty,
+/// otherwise DEFAULT_EMPTY_VALUE
+int pop(stack* stack) {
+    int value = DEFAULT_EMPTY_VALUE;
+
+    if (isEmpty(stack)) {
+        printf("Pop error! Stack is empty.\n");
+    } else {
+        value = stack->top->values[stack->top_index];
+        stack->top_index--;
+        stack->size--;
+
+        if (stack->top_index == -1) {
+            segment* emptied = stack->top;
+            stack->top = emptied->previous;
+            stack->top_index = (int) SEGMENT_SIZE - 1;
+
+            if (stack->top == NULL)
+                stack->bottom = NULL;
+
+            if (stack->spares == NULL) {
+                emptied->previous = NULL;
+                stack->spares = emptied;
+            } else {
+                free(emptied);
+            }
+        }
+    }
+
+    return value;
+}
+
+/// Determines if the stack is empty.
+/// \param stack
+/// \return 1 if empty, otherwise 0
+int isEmpty(stack* stack) {
+    return stack->size == 0;
+}
+
+/// Removes all values from the stack in O(1) by
+/// moving all segments onto the spare list.
+/// \param stack
+/// \return number of values removed from the stack
+long clear(stack* stack) {
+    long count_values_removed = stack->size;
+
+    if (stack->top != NULL) {
+        stack->bottom->previous = stack->spares;
+        stack->spares = stack->top;
+    }
+
+    stack->top = NULL;
+    stack->bottom = NULL;
+    stack->top_index = -1;
+    stack->size = 0;
+
+    return count_values_removed;
+}
+
+/*
+ * Helper Function(s)
+ *
+ */
+
+/// Creates an empty stack.
+/// \return the stack
+stack* createStack(void) {
+    stack* new_stack = calloc(1, sizeof(stack));
+    new_stack->top_index = -1;
+    return new_stack;
+}
+
+/// Frees the stack, its segments and its spares.
+/// \param stack
+void freeStack(stack* stack) {
+    clear(stack);
+    releaseSpares(stack);
+    free(stack);
+}
+
+/// Frees all spare segments.
+/// \param stack
+void releaseSpares(stack* stack) {
+    segment* current_segment = stack->spares;
+
+    while (current_segment != NULL) {
+        segment* next_segment = current_segment->previous;
+        free(current_segment);
+        current_segment = next_segment;
+    }
+
+    stack->spares = NULL;
+}
+
+/// Returns a spare segment, or a new one if
+/// there are no spares.
+/// \param stack
+/// \return the segment, or NULL if out of memory
+segment* takeSegment(stack* stack) {
+    segment* spare = stack->spares;
+
+    if (spare != NULL) {
+        stack->spares = spare->previous;
+        return spare;
+    }
+
+    return malloc(SEGMENT_BYTES);
+}
@@ -0,0 +1,566 @@
+/*
+ *
+ * Work-Stealing Deque (Chase-Lev)
+ *
+ *    Uses:
+ *      Growable Circular Array
+ *
+ *    Sample Operations:
+ *      push, pop, steal, isEmpty
+ *
+ *    Build:
+ *      gcc -O2 -pthread work-stealing-deque.c
+ *
+ * Notes:
+ *
+ * Each worker thread of a task scheduler keeps its tasks on
+ * its own stack, like push and pop in stack-using-array.c.
+ * Running the newest task first keeps its data in the cache.
+ * When a worker runs out of tasks it should take some from a
+ * busy worker, and this deque lets it: the owner pushes and
+ * pops at the bottom, and other threads steal from the top,
+ * where the oldest and usually largest tasks are.
+ *
+ * top and bottom only grow; the array index is the counter
+ * masked by the array size, so the array is circular. Tasks
+ * live at indexes top to bottom - 1.
+ *
+ *   push   stores the task, then publishes it by moving bottom
+ *          with a release store. No CAS, no full fence.
+ *   pop    moves bottom down first, then reads top, so a thief
+ *          either sees the new bottom or the owner sees the
+ *          thief's new top. That needs a full fence, but no
+ *          CAS unless only one task is left, when the owner
+ *          and a thief race for it with a CAS on top.
+ *   steal  reads top, then bottom, and claims the task at top
+ *          with a CAS on top. A thief that loses the race gets
+ *          STEAL_ABORT and may try elsewhere.
+ *
+ * When push finds the array full, it copies the tasks into an
+ * array twice the size. A thief may still be reading the old
+ * array, so old arrays are kept on a list and freed with the
+ * deque. Each one is half the size of the next, so they add
+ * up to less than the current array.
+ *
+ * The memory orders follow "Correct and Efficient Work-Stealing
+ * for Weak Memory Models" (Le, Pop, Cohen, Zappa Nardelli, 2013).
+ *
+ * main() runs a small fork-join scheduler on top of the deque
+ * and shows how recursive fib and array sums scale with the
+ * number of workers.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define INITIAL_CAPACITY 32
+
+#define STEAL_SUCCESS 1
+#define STEAL_EMPTY 0
+#define STEAL_ABORT (-1)
+
+struct worker;
+
+typedef struct task {
+    void (*function)(struct worker*, struct task*);
+    long first; // Arguments of function.
+    long second;
+    long result;
+    atomic_int done;
+} task;
+
+typedef struct task_array {
+    long capacity; // Always a power of two.
+    struct task_array* previous; // Retired, smaller array.
+    _Atomic(task*) items[];
+} task_array;
+
+typedef struct deque {
+    atomic_long top __attribute__((aligned(64)));
+    atomic_long bottom __attribute__((aligned(64)));
+    _Atomic(task_array*) array;
+} deque;
+
+// Deque Implementation
+void push(deque*, task*);
+task* pop(deque*);
+int steal(deque*, task**);
+int isEmpty(deque*);
+
+// Helper Function(s)
+deque* createDeque(void);
+void freeDeque(deque*);
+task_array* createTaskArray(long);
+task_array* grow(deque*, task_array*, long, long);
+
+// Benchmark
+void runBenchmarks(void);
+
+int main() {
+    deque* my_deque = createDeque();
+    task tasks[3];
+    task* stolen;
+
+    printf("isEmpty = %d\n", isEmpty(my_deque));
+
+    for (int i = 0; i < 3; i++) {
+        tasks[i].first = i;
+        push(my_deque, &tasks[i]);
+        printf("Push: task %d\n", i);
+    }
+
+    // The owner takes the newest task,
+    // a thief takes the oldest.
+    printf("Pop: task %ld\n", pop(my_deque)->first);
+    if (steal(my_deque, &stolen) == STEAL_SUCCESS)
+        printf("Steal: task %ld\n", stolen->first);
+    printf("Pop: task %ld\n", pop(my_deque)->first);
+
+    printf("isEmpty = %d\n\n", isEmpty(my_deque));
+
+    freeDeque(my_deque);
+
+    runBenchmarks();
+
+    return 0;
+}
+
+/*
+ *
+ * Deque Implementation
+ *
+ */
+
+/// Adds a task at the bottom. Only the owner
+/// thread may call push.
+/// \param deque
+/// \param item
+void push(deque* deque, task* item) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    task_array* array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+    if (bottom - top > array->capacity - 1)
+        array = grow(deque, array, top, bottom);
+
+    atomic_store_explicit(&array->items[bottom & (array->capacity - 1)],
+                          item, memory_order_relaxed);
+
+    // Publish the task with the new bottom.
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+}
+
+/// Removes the newest task from the bottom. Only
+/// the owner thread may call pop.
+/// \param deque
+/// \return the task, or NULL if empty
+task* pop(deque* deque) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    task_array* array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+    // Claim the bottom slot before looking at top.
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (top > bottom) {
+        // It was empty. Put bottom back.
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    task* item = atomic_load_explicit(&array->items[bottom & (array->capacity - 1)],
+                                      memory_order_relaxed);
+
+    if (top == bottom) {
+        // The last task. Race the thieves for it.
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                     memory_order_seq_cst,
+                                                     memory_order_relaxed))
+            item = NULL;
+
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+
+    return item;
+}
+
+/// Removes the oldest task from the top. Any
+/// thread may call steal.
+/// \param deque
+/// \param item receives the task
+/// \return STEAL_SUCCESS, STEAL_EMPTY, or STEAL_ABORT
+/// if another thread took the task first
+int steal(deque* deque, task** item) {
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+    if (top >= bottom)
+        return STEAL_EMPTY;
+
+    task_array* array = atomic_load_explicit(&deque->array, memory_order_acquire);
+    task* stolen = atomic_load_explicit(&array->items[top & (array->capacity - 1)],
+                                        memory_order_relaxed);
+
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed))
+        return STEAL_ABORT;
+
+    *item = stolen;
+    return STEAL_SUCCESS;
+}
+
+/// Determines if the deque is empty. With other
+/// threads running this is only a snapshot.
+/// \param deque
+/// \return 1 if empty, otherwise 0
+int isEmpty(deque* deque) {
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    return top >= bottom;
+}
+
+/*
+ * Helper Function(s)
+ *
+ */
+
+/// Creates an empty deque.
+/// \return the deque
+deque* createDeque(void) {
+    deque* new_deque = aligned_alloc(64, sizeof(deque));
+    atomic_init(&new_deque->top, 0);
+    atomic_init(&new_deque->bottom, 0);
+    atomic_init(&new_deque->array, createTaskArray(INITIAL_CAPACITY));
+    return new_deque;
+}
+
+/// Frees the deque and all of its arrays. No
+/// other thread may be using the deque.
+/// \param deque
+void freeDeque(deque* deque) {
+    task_array* array = atomic_load(&deque->array);
+
+    while (array != NULL) {
+        task_array* previous = array->previous;
+        free(array);
+        array = previous;
+    }
+
+    free(deque);
+}
+
+/// Creates an empty task array.
+/// \param capacity a power of two
+/// \return the array
+task_array* createTaskArray(long capacity) {
+    task_array* array = calloc(1, sizeof(task_array) + capacity * sizeof(task*));
+    array->capacity = capacity;
+    array->previous = NULL;
+    return array;
+}
+
+/// Copies the tasks into an array twice the size and
+/// makes it the deque's array. The old array is kept
+/// until the deque is freed, because thieves may
+/// still read from it.
+/// \param deque
+/// \param array the current array
+/// \param top
+/// \param bottom
+/// \return the new array
+task_array* grow(deque* deque, task_array* array, long top, long bottom) {
+    task_array* bigger = createTaskArray(array->capacity * 2);
+
+    for (long i = top; i < bottom; i++) {
+        task* item = atomic_load_explicit(&array->items[i & (array->capacity - 1)],
+                                          memory_order_relaxed);
+        atomic_store_explicit(&bigger->items[i & (bigger->capacity - 1)],
+                              item, memory_order_relaxed);
+    }
+
+    bigger->previous = array;
+    atomic_store_explicit(&deque->array, bigger, memory_order_release);
+
+    return bigger;
+}
+
+/*
+ *
+ * Fork-Join Scheduler
+ *
+ */
+
+#define MAX_WORKERS 64
+#define FIB_CUTOFF 16
+#define SUM_CUTOFF 4096
+
+typedef struct worker {
+    deque* tasks;
+    struct scheduler* scheduler;
+    unsigned int random;
+    pthread_t thread;
+} worker;
+
+typedef struct scheduler {
+    worker workers[MAX_WORKERS];
+    int count;
+    atomic_int finished;
+} scheduler;
+
+void runTask(worker*, task*);
+void spawn(worker*, task*);
+void join(worker*, task*);
+task* stealFromOthers(worker*);
+void* workerLoop(void*);
+double runOnScheduler(int, task*);
+
+/// Runs a task and marks it done.
+/// \param self the worker running it
+/// \param item
+void runTask(worker* self, task* item) {
+    item->function(self, item);
+    atomic_store_explicit(&item->done, 1, memory_order_release);
+}
+
+/// Makes a task available to run on this or
+/// any other worker.
+/// \param self
+/// \param item
+void spawn(worker* self, task* item) {
+    atomic_init(&item->done, 0);
+    push(self->tasks, item);
+}
+
+/// Waits for a spawned task. Rather than block, the
+/// worker runs its own tasks, which normally starts
+/// with item itself, and steals once it has none.
+/// \param self
+/// \param item
+void join(worker* self, task* item) {
+    while (!atomic_load_explicit(&item->done, memory_order_acquire)) {
+        task* next = pop(self->tasks);
+
+        if (next == NULL)
+            next = stealFromOthers(self);
+
+        if (next != NULL)
+            runTask(self, next);
+        else
+            sched_yield();
+    }
+}
+
+/// Tries to steal a task from each other worker,
+/// starting at a random one.
+/// \param self
+/// \return the task, or NULL if none was found
+task* stealFromOthers(worker* self) {
+    scheduler* pool = self->scheduler;
+    task* stolen;
+
+    self->random = self->random * 1103515245u + 12345u;
+    int start = (self->random >> 16) % pool->count;
+
+    for (int i = 0; i < pool->count; i++) {
+        worker* victim = &pool->workers[(start + i) % pool->count];
+        if (victim == self)
+            continue;
+
+        if (steal(victim->tasks, &stolen) == STEAL_SUCCESS)
+            return stolen;
+    }
+
+    return NULL;
+}
+
+/// Runs tasks until the scheduler is finished.
+/// \param arg the worker
+/// \return NULL
+void* workerLoop(void* arg) {
+    worker* self = arg;
+
+    while (!atomic_load_explicit(&self->scheduler->finished, memory_order_acquire)) {
+        task* next = pop(self->tasks);
+
+        if (next == NULL)
+            next = stealFromOthers(self);
+
+        if (next != NULL)
+            runTask(self, next);
+        else
+            sched_yield();
+    }
+
+    return NULL;
+}
+
+/// Runs root to completion on count workers.
+/// \param count number of worker threads, from 1 to
+/// MAX_WORKERS
+/// \param root
+/// \return seconds taken, or -1 if count is out of
+/// range or out of memory, and root is not run
+double runOnScheduler(int count, task* root) {
+    if (count < 1 || count > MAX_WORKERS) {
+        printf("Error: %d workers, not from 1 to %d.\n", count, MAX_WORKERS);
+        return -1;
+    }
+
+    scheduler* pool = calloc(1, sizeof(scheduler));
+    struct timespec start, end;
+
+    if (pool == NULL) {
+        printf("Error: out of memory.\n");
+        return -1;
+    }
+
+    pool->count = count;
+    atomic_init(&pool->finished, 0);
+
+    for (int i = 0; i < count; i++) {
+        pool->workers[i].tasks = createDeque();
+        pool->workers[i].scheduler = pool;
+        pool->workers[i].random = i + 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Worker 0 runs on this thread and
+    // starts with the root task.
+    for (int i = 1; i < count; i++)
+        pthread_create(&pool->workers[i].thread, NULL, workerLoop, &pool->workers[i]);
+
+    spawn(&pool->workers[0], root);
+    join(&pool->workers[0], root);
+    atomic_store_explicit(&pool->finished, 1, memory_order_release);
+
+    for (int i = 1; i < count; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (int i = 0; i < count; i++)
+        freeDeque(pool->workers[i].tasks);
+    free(pool);
+
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/*
+ * Recursive Workloads
+ *
+ */
+
+long serialFib(long);
+void fibTask(worker*, task*);
+void sumTask(worker*, task*);
+
+static long* sum_values;
+
+/// Computes fib(n) without any tasks.
+/// \param n
+/// \return fib(n)
+long serialFib(long n) {
+    return n < 2 ? n : serialFib(n - 1) + serialFib(n - 2);
+}
+
+/// Computes fib(first) by spawning fib(first - 1)
+/// and computing fib(first - 2) itself.
+/// \param self
+/// \param item
+void fibTask(worker* self, task* item) {
+    long n = item->first;
+
+    if (n < FIB_CUTOFF) {
+        item->result = serialFib(n);
+        return;
+    }
+
+    task child = {fibTask, n - 1, 0, 0, 0};
+    task same = {fibTask, n - 2, 0, 0, 0};
+
+    spawn(self, &child);
+    fibTask(self, &same);
+    join(self, &child);
+
+    item->result = child.result + same.result;
+}
+
+/// Sums sum_values[first..second) by splitting
+/// the range in half.
+/// \param self
+/// \param item
+void sumTask(worker* self, task* item) {
+    long low = item->first;
+    long high = item->second;
+
+    if (high - low <= SUM_CUTOFF) {
+        long sum = 0;
+        for (long i = low; i < high; i++)
+            sum += sum_values[i];
+        item->result = sum;
+        return;
+    }
+
+    long middle = low + (high - low) / 2;
+    task left = {sumTask, low, middle, 0, 0};
+    task right = {sumTask, middle, high, 0, 0};
+
+    spawn(self, &left);
+    sumTask(self, &right);
+    join(self, &left);
+
+    item->result = left.result + right.result;
+}
+
+/// Prints how fib and array sums scale from 1
+/// worker up to 8.
+void runBenchmarks(void) {
+    const long fib_n = 32;
+    const long sum_count = 1L << 24;
+
+    sum_values = calloc(sum_count, sizeof(long));
+    for (long i = 0; i < sum_count; i++)
+        sum_values[i] = i & 0xff;
+
+    printf("%-8s %12s %8s %12s %8s\n",
+           "workers", "fib(32) s", "speedup", "sum(16M) s", "speedup");
+
+    double fib_base = 0;
+    double sum_base = 0;
+
+    for (int workers = 1; workers <= 8; workers *= 2) {
+        task fib = {fibTask, fib_n, 0, 0, 0};
+        task sum = {sumTask, 0, sum_count, 0, 0};
+
+        double fib_seconds = runOnScheduler(workers, &fib);
+        double sum_seconds = runOnScheduler(workers, &sum);
+
+        if (fib_seconds < 0 || sum_seconds < 0)
+            break;
+
+        if (workers == 1) {
+            fib_base = fib_seconds;
+            sum_base = sum_seconds;
+        }
+
+        printf("%-8d %12.4f %8.2f %12.4f %8.2f\n",
+               workers, fib_seconds, fib_base / fib_seconds,
+               sum_seconds, sum_base / sum_seconds);
+
+        if (fib.result != serialFib(fib_n))
+            printf("Error: fib(%ld) = %ld\n", fib_n, fib.result);
+    }
+
+    free(sum_values);
+}
@@ -0,0 +1,124 @@
+/*
+ *
+ * Binary Search Tree Template
+ *
+ *    Sample Operations:
+ *      add, find, contains, depth, clear
+ *
+ *    Usage:
+ *      #define STRING_COMPARE(a, b) strcmp(a, b)
+ *      DEFINE_BST(name_tree, const char*, STRING_COMPARE)
+ *
+ *      name_tree names;
+ *      name_tree_init(&names);
+ *      name_tree_add(&names, "Martha");
+ *
+ * Notes:
+ *
+ * DEFINE_BST(name, type, compare) writes out the tree of
+ * bst.c for values of type. compare(a, b) returns a number
+ * less than, equal to or greater than 0 when a is less than,
+ * equal to or greater than b, like strcmp. It is written
+ * straight into the loops, so it is inlined.
+ *
+ * Unlike bst.c the tree holds a root pointer rather than
+ * being its root node, so it can be empty.
+ *
+ */
+
+#ifndef TEMPLATES_BST_H
+#define TEMPLATES_BST_H
+
+#include <stdlib.h>
+
+#define DEFINE_BST(name, type, compare)                                       \
+                                                                              \
+typedef struct name##_node {                                                  \
+    type value;                                                               \
+    struct name##_node* left;                                                 \
+    struct name##_node* right;                                                \
+} name##_node;                                                                \
+                                                                              \
+typedef struct name {                                                         \
+    name##_node* root;                                                        \
+} name;                                                                       \
+                                                                              \
+/* Initializes an empty tree.                                              */ \
+static inline void name##_init(name* tree) {                                  \
+    tree->root = NULL;                                                        \
+}                                                                             \
+                                                                              \
+/* Adds the value unless it is already present.                            */ \
+/* Returns 1 if added, 0 if present, -1 if out of memory.                  */ \
+static inline int name##_add(name* tree, type value) {                        \
+    name##_node** link = &tree->root;                                         \
+    while (*link != NULL) {                                                   \
+        int order = compare(value, (*link)->value);                           \
+        if (order < 0)                                                        \
+            link = &(*link)->left;                                            \
+        else if (order > 0)                                                   \
+            link = &(*link)->right;                                           \
+        else                                                                  \
+            return 0;                                                         \
+    }                                                                         \
+    name##_node* new_node = malloc(sizeof(name##_node));                      \
+    if (new_node == NULL)                                                     \
+        return -1;                                                            \
+    new_node->value = value;                                                  \
+    new_node->left = NULL;                                                    \
+    new_node->right = NULL;                                                   \
+    *link = new_node;                                                         \
+    return 1;                                                                 \
+}                                                                             \
+                                                                              \
+/* Returns the stored value equal to value, or NULL if not found.          */ \
+static inline type* name##_find(name* tree, type value) {                     \
+    name##_node* current_node = tree->root;                                   \
+    while (current_node != NULL) {                                            \
+        int order = compare(value, current_node->value);                      \
+        if (order == 0)                                                       \
+            return &current_node->value;                                      \
+        current_node = order < 0 ? current_node->left : current_node->right;  \
+    }                                                                         \
+    return NULL;                                                              \
+}                                                                             \
+                                                                              \
+/* Returns 1 if the value is in the tree, otherwise 0.                     */ \
+static inline int name##_contains(name* tree, type value) {                   \
+    return name##_find(tree, value) != NULL;                                  \
+}                                                                             \
+                                                                              \
+/* Returns the depth of the value, or -1 if not found.                     */ \
+static inline int name##_depth(name* tree, type value) {                      \
+    int depth = 0;                                                            \
+    name##_node* current_node = tree->root;                                   \
+    while (current_node != NULL) {                                            \
+        int order = compare(value, current_node->value);                      \
+        if (order == 0)                                                       \
+            return depth;                                                     \
+        current_node = order < 0 ? current_node->left : current_node->right;  \
+        depth++;                                                              \
+    }                                                                         \
+    return -1;                                                                \
+}                                                                             \
+                                                                              \
+/* Frees every node without recursion: rotating left children up turns    */ \
+/* the tree into a list along the right, which is freed as it is walked.  */ \
+static inline void name##_clear(name* tree) {                                 \
+    name##_node* current_node = tree->root;                                   \
+    while (current_node != NULL) {                                            \
+        name##_node* left = current_node->left;                               \
+        if (left != NULL) {                                                   \
+            current_node->left = left->right;                                 \
+            left->right = current_node;                                       \
+            current_node = left;                                              \
+        } else {                                                              \
+            name##_node* right = current_node->right;                         \
+            free(current_node);                                               \
+            current_node = right;                                             \
+        }                                                                     \
+    }                                                                         \
+    tree->root = NULL;                                                        \
+}
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ *
+ * Linked List Template
+ *
+ *    Uses:
+ *      Head and Tail Pointers
+ *
+ *    Sample Operations:
+ *      add, delete, contains, isEmpty, clear
+ *
+ *    Usage:
+ *      #define POINT_COMPARE(a, b) ((a).x != (b).x || (a).y != (b).y)
+ *      DEFINE_LINKED_LIST(point_list, point, POINT_COMPARE)
+ *
+ *      point_list points;
+ *      point_list_init(&points);
+ *      point_list_add(&points, (point) {1, 2});
+ *
+ * Notes:
+ *
+ * DEFINE_LINKED_LIST(name, type, compare) writes out the
+ * list of head-and-tail-pointers.c for values of type. The
+ * value is stored inside each node.
+ *
+ * compare(a, b) is a function-like macro or a static inline
+ * function that returns 0 when a and b are equal. It is
+ * written straight into delete and contains, so the compiler
+ * inlines it instead of calling through a pointer.
+ *
+ */
+
+#ifndef TEMPLATES_LINKED_LIST_H
+#define TEMPLATES_LINKED_LIST_H
+
+#include <stdlib.h>
+
+#define DEFINE_LINKED_LIST(name, type, compare)                               \
+                                                                              \
+typedef struct name##_node {                                                  \
+    type value;                                                               \
+    struct name##_node* next;                                                 \
+} name##_node;                                                                \
+                                                                              \
+typedef struct name {                                                         \
+    name##_node* head;                                                        \
+    name##_node* tail;                                                        \
+} name;                                                                       \
+                                                                              \
+/* Initializes an empty list.                                              */ \
+static inline void name##_init(name* list) {                                  \
+    list->head = NULL;                                                        \
+    list->tail = NULL;                                                        \
+}                                                                             \
+                                                                              \
+/* Returns 1 if empty, otherwise 0.                                        */ \
+static inline int name##_isEmpty(name* list) {                                \
+    return list->head == NULL;                                                \
+}                                                                             \
+                                                                              \
+/* Adds the value to the end. Returns 0 if out of memory.                  */ \
+static inline int name##_add(name* list, type value) {                        \
+    name##_node* node = malloc(sizeof(name##_node));                          \
+    if (node == NULL)                                                         \
+        return 0;                                                             \
+    node->value = value;                                                      \
+    node->next = NULL;                                                        \
+    if (list->tail == NULL)                                                   \
+        list->head = node;                                                    \
+    else                                                                      \
+        list->tail->next = node;                                              \
+    list->tail = node;                                                        \
+    return 1;                                                                 \
+}                                                                             \
+                                                                              \
+/* Removes the first value equal to value. Returns 1 if found.             */ \
+static inline int name##_delete(name* list, type value) {                     \
+    name##_node* previous_node = NULL;                                        \
+    name##_node* current_node = list->head;                                   \
+    while (current_node != NULL && compare(current_node->value, value) != 0) {\
+        previous_node = current_node;                                         \
+        current_node = current_node->next;                                    \
+    }                                                                         \
+    if (current_node == NULL)                                                 \
+        return 0;                                                             \
+    if (previous_node == NULL)                                                \
+        list->head = current_node->next;                                      \
+    else                                                                      \
+        previous_node->next = current_node->next;                             \
+    if (current_node == list->tail)                                           \
+        list->tail = previous_node;                                           \
+    free(current_node);                                                       \
+    return 1;                                                                 \
+}                                                                             \
+                                                                              \
+/* Returns the first value equal to value, or NULL if not found.           */ \
+static inline type* name##_find(name* list, type value) {                     \
+    for (name##_node* node = list->head; node != NULL; node = node->next) {   \
+        if (compare(node->value, value) == 0)                                 \
+            return &node->value;                                              \
+    }                                                                         \
+    return NULL;                                                              \
+}                                                                             \
+                                                                              \
+/* Returns 1 if the value is in the list, otherwise 0.                     */ \
+static inline int name##_contains(name* list, type value) {                   \
+    return name##_find(list, value) != NULL;                                  \
+}                                                                             \
+                                                                              \
+/* Removes all values. Returns the number removed.                         */ \
+static inline int name##_clear(name* list) {                                  \
+    int count_nodes_deleted = 0;                                              \
+    name##_node* current_node = list->head;                                   \
+    while (current_node != NULL) {                                            \
+        name##_node* next_node = current_node->next;                          \
+        free(current_node);                                                   \
+        count_nodes_deleted++;                                                \
+        current_node = next_node;                                             \
+    }                                                                         \
+    name##_init(list);                                                        \
+    return count_nodes_deleted;                                               \
+}
+
+#endif
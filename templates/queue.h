@@ -0,0 +1,107 @@
+/*
+ *
+ * Queue Template
+ *
+ *    Uses:
+ *      Circular Array
+ *
+ *    Sample Operations:
+ *      enqueue, dequeue, peek, isEmpty, isFull, size
+ *
+ *    Usage:
+ *      DEFINE_QUEUE(double_queue, double)
+ *
+ *      double_queue readings;
+ *      double_queue_init(&readings, 100);
+ *      double_queue_enqueue(&readings, 98.6);
+ *
+ * Notes:
+ *
+ * DEFINE_QUEUE(name, type) writes out the circular array
+ * queue of queue-using-array.c for values of type, with
+ * functions name_enqueue, name_dequeue and so on. All of
+ * them are static inline and the values are stored in the
+ * array itself.
+ *
+ * Instead of setting head and tail to -1 when empty, the
+ * queue keeps a count, which tells empty and full apart
+ * without the special cases.
+ *
+ */
+
+#ifndef TEMPLATES_QUEUE_H
+#define TEMPLATES_QUEUE_H
+
+#include <stdlib.h>
+
+#define DEFINE_QUEUE(name, type)                                              \
+                                                                              \
+typedef struct name {                                                         \
+    type* arr;                                                                \
+    size_t capacity; /* Maximum size of array */                              \
+    size_t head; /* Index of the head of queue. */                            \
+    size_t count; /* Number of values in queue. */                            \
+} name;                                                                       \
+                                                                              \
+/* Initializes an empty queue. Returns 0 if out of memory.                 */ \
+static inline int name##_init(name* que, size_t capacity) {                   \
+    que->arr = calloc(capacity, sizeof(type));                                \
+    que->capacity = capacity;                                                 \
+    que->head = 0;                                                            \
+    que->count = 0;                                                           \
+    return que->arr != NULL;                                                  \
+}                                                                             \
+                                                                              \
+/* Frees the array.                                                        */ \
+static inline void name##_free(name* que) {                                   \
+    free(que->arr);                                                           \
+    que->arr = NULL;                                                          \
+    que->capacity = 0;                                                        \
+    que->count = 0;                                                           \
+}                                                                             \
+                                                                              \
+/* Returns 1 if empty, otherwise 0.                                        */ \
+static inline int name##_isEmpty(name* que) {                                 \
+    return que->count == 0;                                                   \
+}                                                                             \
+                                                                              \
+/* Returns 1 if full, otherwise 0.                                         */ \
+static inline int name##_isFull(name* que) {                                  \
+    return que->count == que->capacity;                                       \
+}                                                                             \
+                                                                              \
+/* Returns the number of values.                                           */ \
+static inline size_t name##_size(name* que) {                                 \
+    return que->count;                                                        \
+}                                                                             \
+                                                                              \
+/* Adds a value to the back. Returns 0 if full.                            */ \
+static inline int name##_enqueue(name* que, type value) {                     \
+    if (name##_isFull(que))                                                   \
+        return 0;                                                             \
+    size_t tail = que->head + que->count;                                     \
+    if (tail >= que->capacity)                                                \
+        tail -= que->capacity;                                                \
+    que->arr[tail] = value;                                                   \
+    que->count++;                                                             \
+    return 1;                                                                 \
+}                                                                             \
+                                                                              \
+/* Removes the front value into *value. Returns 0 if empty.                */ \
+static inline int name##_dequeue(name* que, type* value) {                    \
+    if (name##_isEmpty(que))                                                  \
+        return 0;                                                             \
+    *value = que->arr[que->head];                                             \
+    que->head++;                                                              \
+    if (que->head == que->capacity)                                           \
+        que->head = 0;                                                        \
+    que->count--;                                                             \
+    return 1;                                                                 \
+}                                                                             \
+                                                                              \
+/* Returns the front value, or NULL if empty.                              */ \
+static inline type* name##_peek(name* que) {                                  \
+    return que->count ? &que->arr[que->head] : NULL;                          \
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ *
+ * Self-Organizing List Template
+ *
+ *    Uses:
+ *      Move-To-Front Strategy
+ *
+ *    Sample Operations:
+ *      add, find, clear
+ *
+ *    Usage:
+ *      #define ID_COMPARE(a, b) ((a) != (b))
+ *      #define ID_HASH(key) ((uint32_t) (key) * 2654435761u)
+ *      DEFINE_SELF_ORGANIZING_LIST(age_list, int, int, ID_COMPARE, ID_HASH)
+ *
+ *      age_list ages;
+ *      age_list_init(&ages);
+ *      age_list_add(&ages, 1001, 42);
+ *      int* age = age_list_find(&ages, 1001);
+ *
+ * Notes:
+ *
+ * DEFINE_SELF_ORGANIZING_LIST(name, key_type, value_type,
+ * compare, hash_function) writes out the list of
+ * self-organizing-list.c for any key and value type, instead
+ * of a char name[10] and an int age. New entries go to the
+ * head and a found entry moves to the head.
+ *
+ * compare(a, b) returns 0 when two keys are equal.
+ * hash_function(key) returns a uint32_t. Each node stores the
+ * hash of its key in its hash field, and find compares hashes
+ * before it calls compare, so a key that is not in the list
+ * costs one integer compare per node in almost every case.
+ * Both are written straight into find, so they are inlined.
+ *
+ */
+
+#ifndef TEMPLATES_SELF_ORGANIZING_LIST_H
+#define TEMPLATES_SELF_ORGANIZING_LIST_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define DEFINE_SELF_ORGANIZING_LIST(name, key_type, value_type, compare, hash_function) \
+                                                                              \
+typedef struct name##_node {                                                  \
+    uint32_t hash;                                                            \
+    key_type key;                                                             \
+    value_type value;                                                         \
+    struct name##_node* next;                                                 \
+} name##_node;                                                                \
+                                                                              \
+typedef struct name {                                                         \
+    name##_node* head;                                                        \
+} name;                                                                       \
+                                                                              \
+/* Initializes an empty list.                                              */ \
+static inline void name##_init(name* list) {                                  \
+    list->head = NULL;                                                        \
+}                                                                             \
+                                                                              \
+/* Adds an entry to the head. Returns 0 if out of memory.                  */ \
+static inline int name##_add(name* list, key_type key, value_type value) {    \
+    name##_node* new_node = malloc(sizeof(name##_node));                      \
+    if (new_node == NULL)                                                     \
+        return 0;                                                             \
+    new_node->hash = (uint32_t) (hash_function(key));                         \
+    new_node->key = key;                                                      \
+    new_node->value = value;                                                  \
+    new_node->next = list->head;                                              \
+    list->head = new_node;                                                    \
+    return 1;                                                                 \
+}                                                                             \
+                                                                              \
+/* Returns the value of key and moves its node to the head,               */ \
+/* or returns NULL if not found.                                           */ \
+static inline value_type* name##_find(name* list, key_type key) {             \
+    uint32_t key_hash = (uint32_t) (hash_function(key));                      \
+    name##_node* previous_node = NULL;                                        \
+    name##_node* current_node = list->head;                                   \
+    while (current_node != NULL) {                                            \
+        if (current_node->hash == key_hash                                    \
+            && compare(current_node->key, key) == 0)                          \
+            break;                                                            \
+        previous_node = current_node;                                         \
+        current_node = current_node->next;                                    \
+    }                                                                         \
+    if (current_node == NULL)                                                 \
+        return NULL;                                                          \
+    if (previous_node != NULL) {                                              \
+        previous_node->next = current_node->next;                             \
+        current_node->next = list->head;                                      \
+        list->head = current_node;                                            \
+    }                                                                         \
+    return &current_node->value;                                              \
+}                                                                             \
+                                                                              \
+/* Removes all entries.                                                    */ \
+static inline void name##_clear(name* list) {                                 \
+    name##_node* current_node = list->head;                                   \
+    while (current_node != NULL) {                                            \
+        name##_node* next_node = current_node->next;                          \
+        free(current_node);                                                   \
+        current_node = next_node;                                             \
+    }                                                                         \
+    list->head = NULL;                                                        \
+}
+
+#endif
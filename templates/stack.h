@@ -0,0 +1,119 @@
+/*
+ *
+ * Stack Template
+ *
+ *    Uses:
+ *      Growable Array
+ *
+ *    Sample Operations:
+ *      push, peek, pop, isEmpty, size, reserve
+ *
+ *    Usage:
+ *      DEFINE_STACK(int_stack, int)
+ *
+ *      int_stack numbers;
+ *      int_stack_init(&numbers);
+ *      int_stack_push(&numbers, 42);
+ *
+ * Notes:
+ *
+ * DEFINE_STACK(name, type) writes out a stack of type named
+ * name, with functions name_push, name_pop and so on. The
+ * values are stored in the array itself, not behind void
+ * pointers, and every function is static inline, so each
+ * element type gets its own code, just as if stack-using-array.c
+ * had been copied and edited by hand.
+ *
+ * The array grows and shrinks like stack-using-array.c:
+ * doubling when full, halving once a quarter full.
+ *
+ * There is no value of an arbitrary type that can mean
+ * "empty", so pop and peek report an empty stack through
+ * their return value instead of a DEFAULT_VALUE.
+ *
+ */
+
+#ifndef TEMPLATES_STACK_H
+#define TEMPLATES_STACK_H
+
+#include <stdlib.h>
+
+#define STACK_MIN_CAPACITY 16
+
+#define DEFINE_STACK(name, type)                                              \
+                                                                              \
+typedef struct name {                                                         \
+    type* array;                                                              \
+    size_t size;                                                              \
+    size_t capacity;                                                          \
+} name;                                                                       \
+                                                                              \
+/* Moves the values to an array of the given capacity.                     */ \
+static inline int name##_resize(name* stack, size_t capacity) {               \
+    type* array = realloc(stack->array, capacity * sizeof(type));             \
+    if (array == NULL)                                                        \
+        return 0;                                                             \
+    stack->array = array;                                                     \
+    stack->capacity = capacity;                                               \
+    return 1;                                                                 \
+}                                                                             \
+                                                                              \
+/* Initializes an empty stack. Nothing is allocated until the first push. */ \
+static inline void name##_init(name* stack) {                                 \
+    stack->array = NULL;                                                      \
+    stack->size = 0;                                                          \
+    stack->capacity = 0;                                                      \
+}                                                                             \
+                                                                              \
+/* Frees the array and leaves the stack empty.                             */ \
+static inline void name##_free(name* stack) {                                 \
+    free(stack->array);                                                       \
+    name##_init(stack);                                                       \
+}                                                                             \
+                                                                              \
+/* Adds a value. Returns 1, or 0 if out of memory.                         */ \
+static inline int name##_push(name* stack, type value) {                      \
+    if (stack->size == stack->capacity) {                                     \
+        size_t capacity = stack->capacity ? stack->capacity * 2               \
+                                          : STACK_MIN_CAPACITY;               \
+        if (!name##_resize(stack, capacity))                                  \
+            return 0;                                                         \
+    }                                                                         \
+    stack->array[stack->size++] = value;                                      \
+    return 1;                                                                 \
+}                                                                             \
+                                                                              \
+/* Returns the last value added, or NULL if empty.                         */ \
+static inline type* name##_peek(name* stack) {                                \
+    return stack->size ? &stack->array[stack->size - 1] : NULL;               \
+}                                                                             \
+                                                                              \
+/* Removes the last value added into *value. Returns 0 if empty.           */ \
+static inline int name##_pop(name* stack, type* value) {                      \
+    if (stack->size == 0)                                                     \
+        return 0;                                                             \
+    *value = stack->array[--stack->size];                                     \
+    if (stack->capacity > STACK_MIN_CAPACITY                                  \
+        && stack->size <= stack->capacity / 4)                                \
+        name##_resize(stack, stack->capacity / 2);                            \
+    return 1;                                                                 \
+}                                                                             \
+                                                                              \
+/* Returns 1 if empty, otherwise 0.                                        */ \
+static inline int name##_isEmpty(name* stack) {                               \
+    return stack->size == 0;                                                  \
+}                                                                             \
+                                                                              \
+/* Returns the number of values.                                           */ \
+static inline size_t name##_size(name* stack) {                               \
+    return stack->size;                                                       \
+}                                                                             \
+                                                                              \
+/* Makes room for capacity values. Returns 0 if out of memory.             */ \
+static inline int name##_reserve(name* stack, size_t capacity) {              \
+    if (capacity <= stack->capacity)                                          \
+        return 1;                                                             \
+    return name##_resize(stack, capacity);                                    \
+}
+
+#endif
@@ -0,0 +1,172 @@
+/*
+ *
+ * Template Containers Demo
+ *
+ *    Uses:
+ *      stack.h, queue.h, linked-list.h, bst.h,
+ *      self-organizing-list.h
+ *
+ * Notes:
+ *
+ * Each DEFINE_ line below writes out one container for one
+ * element type. The compare and hash macros are pasted into
+ * the generated functions, so there are no function pointer
+ * calls and no void pointers anywhere.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bst.h"
+#include "linked-list.h"
+#include "queue.h"
+#include "self-organizing-list.h"
+#include "stack.h"
+
+typedef struct point {
+    int x;
+    int y;
+} point;
+
+// Names up to 15 characters, stored inline in each node.
+typedef struct short_name {
+    char text[16];
+} short_name;
+
+#define INT_COMPARE(a, b) (((a) > (b)) - ((a) < (b)))
+#define POINT_COMPARE(a, b) ((a).x != (b).x || (a).y != (b).y)
+#define NAME_COMPARE(a, b) strcmp((a).text, (b).text)
+
+static inline uint32_t hashName(short_name name) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (const char* c = name.text; *c != '\0'; c++) {
+        hash ^= (unsigned char) *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+DEFINE_STACK(int_stack, int)
+DEFINE_QUEUE(double_queue, double)
+DEFINE_LINKED_LIST(point_list, point, POINT_COMPARE)
+DEFINE_BST(int_tree, int, INT_COMPARE)
+DEFINE_SELF_ORGANIZING_LIST(family_list, short_name, int, NAME_COMPARE, hashName)
+
+// Helper Function(s)
+short_name makeName(const char*);
+void printFamily(family_list*);
+
+int main() {
+    // Stack of int
+    int_stack numbers;
+    int_stack_init(&numbers);
+
+    for (int value = 200; value > 150; value -= 10)
+        printf("Push: %d\n", int_stack_push(&numbers, value) ? value : -1);
+
+    int popped;
+    while (int_stack_pop(&numbers, &popped))
+        printf("Pop: %d\n", popped);
+
+    int_stack_free(&numbers);
+    printf("\n");
+
+    // Queue of double
+    double_queue readings;
+    double_queue_init(&readings, 4);
+
+    double reading = 98.6;
+    while (double_queue_enqueue(&readings, reading))
+        printf("Enqueue: %.1f\n", reading++);
+
+    while (double_queue_dequeue(&readings, &reading))
+        printf("Dequeue: %.1f\n", reading);
+
+    double_queue_free(&readings);
+    printf("\n");
+
+    // Linked list of struct point
+    point_list points;
+    point_list_init(&points);
+
+    for (int i = 1; i <= 3; i++)
+        point_list_add(&points, (point) {i, i * i});
+
+    printf("Contains (2, 4)? %s\n",
+           point_list_contains(&points, (point) {2, 4}) ? "Yes" : "No");
+    printf("Delete: (2, 4) => %s\n",
+           point_list_delete(&points, (point) {2, 4}) ? "Ok" : "Not Found");
+    printf("Contains (2, 4)? %s\n",
+           point_list_contains(&points, (point) {2, 4}) ? "Yes" : "No");
+    printf("Clear List. Records Deleted: %d\n\n", point_list_clear(&points));
+
+    // BST of int, in the same order as bst.c
+    int_tree tree;
+    int_tree_init(&tree);
+
+    int values[] = {40, 20, 10, 30, 60, 50, 70};
+    for (int i = 0; i < 7; i++)
+        int_tree_add(&tree, values[i]);
+
+    for (int i = 10; i < 80; i = i + 10)
+        printf("Depth  %2d? %d\n", i, int_tree_depth(&tree, i));
+
+    int_tree_clear(&tree);
+    printf("\n");
+
+    // Self-organizing list keyed by name, as in
+    // self-organizing-list.c
+    family_list family;
+    family_list_init(&family);
+
+    family_list_add(&family, makeName("John"), 42);
+    family_list_add(&family, makeName("Martha"), 38);
+    family_list_add(&family, makeName("Rosco"), 12);
+    family_list_add(&family, makeName("Cal"), 10);
+    family_list_add(&family, makeName("Trish"), 7);
+
+    printFamily(&family);
+
+    const char* lookups[] = {"Trish", "Cal", "Rosco", "Martha", "John"};
+    for (int i = 0; i < 5; i++)
+        family_list_find(&family, makeName(lookups[i]));
+
+    printFamily(&family);
+
+    int* age = family_list_find(&family, makeName("Martha"));
+    printf("Martha is %d\n", age != NULL ? *age : -1);
+
+    family_list_clear(&family);
+
+    return 0;
+}
+
+/*
+ * Helper Function(s)
+ *
+ */
+
+/// Copies text into a short_name, cutting it
+/// off after 15 characters.
+/// \param text
+/// \return the name
+short_name makeName(const char* text) {
+    short_name name;
+    memset(&name, 0, sizeof(name));
+    strncpy(name.text, text, sizeof(name.text) - 1);
+    return name;
+}
+
+/// Prints the names of all people in the list.
+/// \param list
+void printFamily(family_list* list) {
+    for (family_list_node* node = list->head; node != NULL; node = node->next) {
+        if (node->hash != hashName(node->key))
+            printf("Error: wrong hash for %s\n", node->key.text);
+        printf("%10s", node->key.text);
+    }
+    printf("\n\n");
+}